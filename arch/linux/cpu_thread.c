@@ -1,6 +1,7 @@
 #include "cpu_thread.h"
 #include "kernel/thread.h"
 #include "kernel/os_assert.h"
+#include "kernel/api_stats.h"
 
 #include <stdio.h>
 #include <assert.h>
@@ -17,6 +18,11 @@
 #include <limits.h>
 #include <string.h>
 
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
 //-----------------------------------------------------------------
 // Locals:
 //-----------------------------------------------------------------
@@ -25,9 +31,35 @@ static int               _initial_switch = 0;
 static sigset_t          _sig_alarm;
 static ucontext_t        _initial_ctx;
 
+#ifdef CONFIG_RTOS_HRTIMER
+// One-shot timer for high resolution sleeps (raises SIGALRM)
+static timer_t           _hr_timer;
+#endif
+
 #define DISABLE_TICK()    sigprocmask(SIG_BLOCK,   &_sig_alarm, NULL);
 #define ENABLE_TICK()     sigprocmask(SIG_UNBLOCK, &_sig_alarm, NULL);
 
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+static int               _perf_fd[CPU_THREAD_PERF_COUNTERS];
+static uint64_t          _perf_last[CPU_THREAD_PERF_COUNTERS];
+
+static const uint64_t    _perf_config[CPU_THREAD_PERF_COUNTERS] =
+{
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static const char *      _perf_names[CPU_THREAD_PERF_COUNTERS] =
+{
+    "instructions",
+    "cycles",
+    "cache_misses",
+    "branch_misses"
+};
+#endif
+
 //-----------------------------------------------------------------
 // cpu_thread_init_tcb:
 //-----------------------------------------------------------------
@@ -39,11 +71,15 @@ void cpu_thread_init_tcb(struct cpu_tcb *tcb, void (*func)(void *), void *funcAr
     // Critical depth = 0 so not in critical section (ints enabled)
     tcb->critical_depth = 0;
 
+#ifdef CPU_THREAD_PERF_COUNTERS
+    memset(tcb->perf, 0, sizeof(tcb->perf));
+#endif
+
     // Create thread context
     getcontext (&tcb->ctx);
     tcb->ctx.uc_link = &_initial_ctx;
     tcb->ctx.uc_stack.ss_sp = stack;
-    tcb->ctx.uc_stack.ss_size = stack_size * sizeof (uint32_t);
+    tcb->ctx.uc_stack.ss_size = stack_size * sizeof (stk_t);
     makecontext (&tcb->ctx, (void (*) (void)) func, 1, funcArg);
 }
 //-----------------------------------------------------------------
@@ -91,6 +127,77 @@ void cpu_critical_end(int cr)
 
     return;
 }
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+//-----------------------------------------------------------------
+// cpu_perf_open: Open host performance counters for this process
+// (counters which are unavailable, e.g. due to perf_event_paranoid or
+// virtualisation, read as zero - see cpu_perf_status)
+//-----------------------------------------------------------------
+static void cpu_perf_open(void)
+{
+    struct perf_event_attr attr;
+    int i;
+
+    for (i=0;i<CPU_THREAD_PERF_COUNTERS;i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.type           = PERF_TYPE_HARDWARE;
+        attr.size           = sizeof(attr);
+        attr.config         = _perf_config[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+
+        _perf_fd[i]   = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        _perf_last[i] = 0;
+
+        // Keep the reason for cpu_perf_status
+        if (_perf_fd[i] < 0)
+            _perf_fd[i] = -errno;
+    }
+}
+//-----------------------------------------------------------------
+// cpu_perf_update: Charge counts since the last update to 'tcb'
+// (NULL = discard). Called only when the running thread changes.
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+void cpu_perf_update(struct cpu_tcb *tcb)
+{
+    uint64_t value;
+    int i;
+
+    for (i=0;i<CPU_THREAD_PERF_COUNTERS;i++)
+    {
+        if (_perf_fd[i] < 0 || read(_perf_fd[i], &value, sizeof(value)) != sizeof(value))
+            continue;
+
+        if (tcb)
+            tcb->perf[i] += value - _perf_last[i];
+
+        _perf_last[i] = value;
+    }
+}
+//-----------------------------------------------------------------
+// cpu_perf_name: Performance counter name
+//-----------------------------------------------------------------
+const char * cpu_perf_name(int idx)
+{
+    if (idx < 0 || idx >= CPU_THREAD_PERF_COUNTERS)
+        return "unknown";
+
+    return _perf_names[idx];
+}
+//-----------------------------------------------------------------
+// cpu_perf_status: 0 if the counter is available, else -errno from
+// opening it (only valid once the scheduler has started)
+//-----------------------------------------------------------------
+int cpu_perf_status(int idx)
+{
+    if (idx < 0 || idx >= CPU_THREAD_PERF_COUNTERS)
+        return -EINVAL;
+
+    return _perf_fd[idx] < 0 ? _perf_fd[idx] : 0;
+}
+#endif
 //-----------------------------------------------------------------
 // cpu_context_switch:
 //-----------------------------------------------------------------
@@ -98,6 +205,7 @@ void cpu_context_switch( void )
 {
     struct thread* suspend_thread;
     struct thread* resume_thread;
+    API_STATS_BEGIN();
 
     // Check that this not occuring recursively!
     OS_ASSERT(!_in_interrupt);
@@ -116,8 +224,16 @@ void cpu_context_switch( void )
 
     // Resume new thread
     resume_thread = thread_current();
+
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+    // Charge counts since the last switch to the outgoing thread
+    if (resume_thread != suspend_thread)
+        cpu_perf_update(suspend_thread ? &suspend_thread->tcb : NULL);
+#endif
     _in_interrupt = 0;
 
+    API_STATS_END(API_STATS_CPU_CONTEXT_SWITCH);
+
     // Only suspend and resume if actually needed
     if (resume_thread != suspend_thread)
     {
@@ -137,22 +253,33 @@ void cpu_context_switch_irq( void )
     OS_ASSERT(_in_interrupt);
 }
 //-----------------------------------------------------------------
-// cpu_tick:
+// cpu_timer_irq: Kernel tick or one-shot timer expiry
 //-----------------------------------------------------------------
-static CRITICALFUNC void cpu_tick(int sig)
+static CRITICALFUNC void cpu_timer_irq(int tick)
 {
     struct thread* suspend_thread;
     struct thread* resume_thread;
+    API_STATS_BEGIN();
 
     // Check that this not occuring recursively!
     OS_ASSERT(!_in_interrupt);
     _in_interrupt = 1;
 
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_enter(THREAD_IRQ_TICK);
+#endif
+
     // Suspend current thread
     suspend_thread = thread_current();
 
     // Decrement thread sleep timers
-    thread_tick();
+    if (tick)
+        thread_tick();
+#ifdef CONFIG_RTOS_HRTIMER
+    // Wake expired high resolution sleepers
+    else
+        thread_hrtimer_irq();
+#endif
 
     // Load new thread context
     thread_load_context(1);
@@ -160,8 +287,21 @@ static CRITICALFUNC void cpu_tick(int sig)
     // Resume new thread
     resume_thread = thread_current();
 
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+    // Charge counts since the last switch to the interrupted thread
+    // (ticks which do not switch leave the counters running)
+    if (resume_thread != suspend_thread)
+        cpu_perf_update(suspend_thread ? &suspend_thread->tcb : NULL);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_exit();
+#endif
+
     _in_interrupt = 0;
 
+    API_STATS_END(API_STATS_CPU_TICK);
+
     // Only suspend and resume if actually needed
     if (resume_thread != suspend_thread)
     {
@@ -172,24 +312,75 @@ static CRITICALFUNC void cpu_tick(int sig)
     }
 }
 //-----------------------------------------------------------------
+// cpu_tick:
+//-----------------------------------------------------------------
+static CRITICALFUNC void cpu_tick(int sig)
+{
+    cpu_timer_irq(1);
+}
+#ifdef CONFIG_RTOS_HRTIMER
+//-----------------------------------------------------------------
+// cpu_hrtimer: One-shot timer expiry
+//-----------------------------------------------------------------
+static CRITICALFUNC void cpu_hrtimer(int sig)
+{
+    cpu_timer_irq(0);
+}
+//-----------------------------------------------------------------
+// cpu_hrtimer_set: Arm one-shot timer for a cpu_timenow() value
+// (0 = disarm). A time already passed expires immediately.
+//-----------------------------------------------------------------
+void cpu_hrtimer_set(uint64_t wake_time)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec  = wake_time / 1000000000ULL;
+    its.it_value.tv_nsec = wake_time % 1000000000ULL;
+    timer_settime(_hr_timer, TIMER_ABSTIME, &its, NULL);
+}
+#endif
+//-----------------------------------------------------------------
 // cpu_thread_start:
 //-----------------------------------------------------------------
 void cpu_thread_start( void )
 {
     struct itimerval itimer, oitimer;
     struct sigaction sigtick;
+#ifdef CONFIG_RTOS_HRTIMER
+    struct sigevent  sigev;
+#endif
 
     _initial_switch = 1;    
 
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+    cpu_perf_open();
+#endif
+
     getcontext (&_initial_ctx);
 
-    // Register tick handler
+    sigemptyset(&_sig_alarm);
+    sigaddset(&_sig_alarm, SIGVTALRM);
+#ifdef CONFIG_RTOS_HRTIMER
+    sigaddset(&_sig_alarm, SIGALRM);
+#endif
+
+    // Register tick handler (timer interrupts do not nest)
     memset(&sigtick, 0, sizeof(sigtick));
     sigtick.sa_handler = cpu_tick;
+    sigtick.sa_mask    = _sig_alarm;
     sigaction(SIGVTALRM, &sigtick, NULL);
 
-    sigemptyset(&_sig_alarm);
-    sigaddset(&_sig_alarm, SIGVTALRM);
+#ifdef CONFIG_RTOS_HRTIMER
+    // One-shot timer on the same clock as cpu_timenow
+    sigtick.sa_handler = cpu_hrtimer;
+    sigaction(SIGALRM, &sigtick, NULL);
+
+    memset(&sigev, 0, sizeof(sigev));
+    sigev.sigev_notify = SIGEV_SIGNAL;
+    sigev.sigev_signo  = SIGALRM;
+    timer_create(CLOCK_MONOTONIC, &sigev, &_hr_timer);
+#endif
 
     // Configure timer
     itimer.it_interval.tv_sec  = 0;
@@ -249,6 +440,24 @@ void cpu_idle(void)
 {
     // Do nothing
 }
+//-----------------------------------------------------------------
+// cpu_timenow: Monotonic time (nanoseconds)
+//-----------------------------------------------------------------
+uint64_t cpu_timenow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+//-----------------------------------------------------------------
+// cpu_timediff: Difference between two cpu_timenow() values (a - b)
+//-----------------------------------------------------------------
+int64_t cpu_timediff(uint64_t a, uint64_t b)
+{
+    return (int64_t)(a - b);
+}
 
 #ifdef INCLUDE_TEST_MAIN
 //-----------------------------------------------------------------
@@ -14,6 +14,19 @@
     #define CRITICALFUNC
 #endif
 
+// cpu_timenow is in ns: wake latency histogram bucket 0 ends at 1024ns
+#define CPU_WAKE_HIST_SHIFT     9
+
+#ifdef CONFIG_RTOS_PERF_COUNTERS
+// Host hardware performance counters accumulated per thread
+#define CPU_THREAD_PERF_COUNTERS    4
+
+#define CPU_PERF_INSTRUCTIONS       0
+#define CPU_PERF_CYCLES             1
+#define CPU_PERF_CACHE_MISSES       2
+#define CPU_PERF_BRANCH_MISSES      3
+#endif
+
 //-----------------------------------------------------------------
 // Structures
 //-----------------------------------------------------------------
@@ -28,6 +41,11 @@ struct cpu_tcb
 
     // Critical section / Interrupt status
     uint32_t   critical_depth;
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    // Performance counter totals whilst this thread was running
+    uint64_t   perf[CPU_THREAD_PERF_COUNTERS];
+#endif
 };
 
 typedef uint64_t stk_t;
@@ -65,6 +83,23 @@ int     cpu_thread_stack_size(struct cpu_tcb * pCurrent);
 uint64_t cpu_timenow(void);
 int64_t  cpu_timediff(uint64_t a, uint64_t b);
 
+#ifdef CONFIG_RTOS_HRTIMER
+// Arm one-shot timer for cpu_timenow() value wake_time (0 = disarm),
+// expiry calls thread_hrtimer_irq then thread_load_context
+void     cpu_hrtimer_set(uint64_t wake_time);
+#endif
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+// Charge performance counts since the last update to a thread's TCB
+void    cpu_perf_update(struct cpu_tcb *tcb);
+
+// Performance counter name
+const char * cpu_perf_name(int idx);
+
+// 0 if the counter could be opened, else -errno (counter reads as zero)
+int     cpu_perf_status(int idx);
+#endif
+
 // System specific assert handling function
 void    cpu_thread_assert(const char *reason, const char *file, int line);
 
@@ -1,6 +1,7 @@
 #include "cpu_thread.h"
 #include "kernel/thread.h"
 #include "kernel/os_assert.h"
+#include "kernel/api_stats.h"
 
 #include "exception.h"
 #include "csr.h"
@@ -19,6 +20,12 @@
 // Preempt rate
 #define TICK_RATE_HZ            1000
 
+#ifdef CONFIG_RTOS_PC_SAMPLING
+#if (CPU_PC_SAMPLE_ENTRIES & (CPU_PC_SAMPLE_ENTRIES - 1)) != 0
+    #error "CPU_PC_SAMPLE_ENTRIES must be a power of 2"
+#endif
+#endif
+
 //-----------------------------------------------------------------
 // Locals:
 //-----------------------------------------------------------------
@@ -26,6 +33,23 @@
 static volatile uint32_t _in_interrupt    = 0;
 static fp_irq            _platform_irq_cb = 0;
 
+// Kernel state changed by an external interrupt handler, reschedule on exit
+static volatile uint32_t _irq_switch      = 0;
+
+#ifdef CONFIG_RTOS_HRTIMER
+// mtimecmp is shared by the tick and the one-shot timer, next tick (mtime)
+static uint64_t          _tick_due;
+#endif
+
+#ifdef CONFIG_RTOS_PC_SAMPLING
+// (thread, PC) sample histogram (open addressing hash)
+static struct cpu_pc_sample _pc_samples[CPU_PC_SAMPLE_ENTRIES];
+static volatile int      _pc_sample_rate  = CPU_PC_SAMPLE_RATE;
+static int               _pc_sample_count = 0;
+static volatile uint32_t _pc_sample_total = 0;
+static volatile uint32_t _pc_sample_dropped = 0;
+#endif
+
 //-----------------------------------------------------------------
 // cpu_thread_init_tcb: Initialise thread context
 //-----------------------------------------------------------------
@@ -110,9 +134,10 @@ void cpu_context_switch( void )
 //-----------------------------------------------------------------
 void cpu_context_switch_irq( void )
 {
-    // No need to do anything in this system as all interrupts
-    // cause the kernel to run...
+    // Timer interrupts always run the kernel, external ones only do
+    // when asked
     OS_ASSERT(_in_interrupt);
+    _irq_switch = 1;
 }
 //-----------------------------------------------------------------
 // cpu_syscall: Handle system call exception
@@ -120,6 +145,7 @@ void cpu_context_switch_irq( void )
 static CRITICALFUNC struct irq_context * cpu_syscall(struct irq_context *ctx)
 {
     struct thread* thread;
+    API_STATS_BEGIN();
 
     // Check that this not occuring recursively!
     OS_ASSERT(!_in_interrupt);
@@ -151,19 +177,139 @@ static CRITICALFUNC struct irq_context * cpu_syscall(struct irq_context *ctx)
 
     _in_interrupt = 0;
 
+    API_STATS_END(API_STATS_CPU_CONTEXT_SWITCH);
+
     return ctx;
 }
+#ifdef CONFIG_RTOS_PC_SAMPLING
+//-----------------------------------------------------------------
+// cpu_pc_sample: Record interrupted PC against the current thread
+// NOTE: Called from timer interrupt
+//-----------------------------------------------------------------
+static CRITICALFUNC NO_PROFILE void cpu_pc_sample(struct thread *thread, uint32_t pc)
+{
+    struct cpu_pc_sample *entry;
+    uint32_t idx;
+    int i;
+
+    if (_pc_sample_rate == 0 || ++_pc_sample_count < _pc_sample_rate)
+        return;
+
+    _pc_sample_count = 0;
+    _pc_sample_total++;
+
+    idx = (pc >> 1) ^ ((uint32_t)thread->thread_id * 0x9E3779B1);
+
+    for (i=0;i<CPU_PC_SAMPLE_PROBES;i++)
+    {
+        entry = &_pc_samples[(idx + i) & (CPU_PC_SAMPLE_ENTRIES - 1)];
+
+        // Existing entry
+        if (entry->count && entry->pc == pc && entry->thread_id == thread->thread_id)
+        {
+            if (entry->count != 0xFFFFFFFF)
+                entry->count++;
+            return;
+        }
+        // Free entry
+        else if (entry->count == 0)
+        {
+            entry->pc        = pc;
+            entry->thread_id = thread->thread_id;
+            entry->count     = 1;
+            return;
+        }
+    }
+
+    // Histogram full (around this key)
+    _pc_sample_dropped++;
+}
+//-----------------------------------------------------------------
+// cpu_pc_sample_rate: Set sampling rate (ticks per sample, 0 = off)
+//-----------------------------------------------------------------
+void cpu_pc_sample_rate(int ticks)
+{
+    OS_ASSERT(ticks >= 0);
+
+    _pc_sample_rate = ticks;
+}
+//-----------------------------------------------------------------
+// cpu_pc_sample_reset: Clear sample histogram
+//-----------------------------------------------------------------
+void cpu_pc_sample_reset(void)
+{
+    int i;
+    int cr = cpu_critical_start();
+
+    for (i=0;i<CPU_PC_SAMPLE_ENTRIES;i++)
+        _pc_samples[i].count = 0;
+
+    _pc_sample_count   = 0;
+    _pc_sample_total   = 0;
+    _pc_sample_dropped = 0;
+
+    cpu_critical_end(cr);
+}
+//-----------------------------------------------------------------
+// cpu_pc_sample_dump: Dump sample histogram as CSV
+// (one row per thread & PC: thread_id,name,pc,count)
+//-----------------------------------------------------------------
+void cpu_pc_sample_dump(int (*os_printf)(const char* ctrl1, ... ))
+{
+    struct cpu_pc_sample sample;
+    struct thread *thread;
+    char name[THREAD_NAME_LEN];
+    int i;
+    int l;
+    int cr;
+
+    os_printf("# pcprof rate=%d total=%ld dropped=%ld\r\n", _pc_sample_rate, _pc_sample_total, _pc_sample_dropped);
+    os_printf("thread_id,name,pc,count\r\n");
+
+    for (i=0;i<CPU_PC_SAMPLE_ENTRIES;i++)
+    {
+        // Take a copy of the entry and the thread name (if still alive)
+        cr = cpu_critical_start();
+
+        sample = _pc_samples[i];
+        name[0] = '?';
+        name[1] = 0;
+
+        if (sample.count)
+        {
+            for (thread = thread_get_first_thread(); thread ; thread = thread->next_all)
+                if (thread->thread_id == sample.thread_id)
+                {
+                    for (l=0;l<THREAD_NAME_LEN;l++)
+                        name[l] = thread->name[l];
+                    name[THREAD_NAME_LEN-1] = 0;
+                    break;
+                }
+        }
+
+        cpu_critical_end(cr);
+
+        if (sample.count)
+            os_printf("%d,%s,0x%08lx,%ld\r\n", sample.thread_id, name, sample.pc, sample.count);
+    }
+}
+#endif
 //-----------------------------------------------------------------
 // cpu_timer_irq: Handle (timer) interrupt exception
 //-----------------------------------------------------------------
 static CRITICALFUNC struct irq_context * cpu_timer_irq(struct irq_context *ctx)
 {
     struct thread* thread;
+    API_STATS_BEGIN();
 
     // Check that this not occuring recursively!
     OS_ASSERT(!_in_interrupt);
     _in_interrupt = 1;
 
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_enter(THREAD_IRQ_TICK);
+#endif
+
     // Record stack pointer in current task TCB
     thread = thread_current();
     if (thread)
@@ -176,17 +322,35 @@ static CRITICALFUNC struct irq_context * cpu_timer_irq(struct irq_context *ctx)
         
         // Try and detect stack overflow
         OS_ASSERT(thread->tcb.stack_alloc[0] == STACK_CHK_BYTE);
+
+#ifdef CONFIG_RTOS_PC_SAMPLING
+        cpu_pc_sample(thread, ctx->pc);
+#endif
+    }
+
+#ifdef CONFIG_RTOS_HRTIMER
+    // Tick and / or one-shot expiry
+    if ((int64_t)(timer_get_mtime() - _tick_due) >= 0)
+    {
+        thread_tick();
+        _tick_due = timer_get_mtime() + (MCU_CLK/TICK_RATE_HZ);
     }
 
+    // Wake high resolution sleepers, re-arms the compare for
+    // whichever of the tick or one-shot is next
+    thread_hrtimer_irq();
+#else
     // Handle thread scheduling
     thread_tick();
 
     // Reset timer (ack pending interrupt)
     timer_set_mtimecmp(timer_get_mtime() + (MCU_CLK/TICK_RATE_HZ));
+#endif
     csr_clear(mip, SR_IP_MTIP);
     csr_set(mie, SR_IP_MTIP);
     
     // Load new thread context
+    _irq_switch = 0;
     thread_load_context(1);
 
     // Get stack frame of new thread
@@ -196,25 +360,94 @@ static CRITICALFUNC struct irq_context * cpu_timer_irq(struct irq_context *ctx)
     // Try and detect stack overflow
     OS_ASSERT(thread->tcb.stack_alloc[0] == STACK_CHK_BYTE);
 
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_exit();
+#endif
+
     _in_interrupt = 0;
 
+    API_STATS_END(API_STATS_CPU_TICK);
+
     return ctx;
 }
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+//-----------------------------------------------------------------
+// cpu_irq_source: Interrupt time accounting source for the pending
+// external interrupt (override in the platform to decode the source)
+//-----------------------------------------------------------------
+WEAK int cpu_irq_source(void)
+{
+    return THREAD_IRQ_EXT;
+}
+#endif
 //-----------------------------------------------------------------
 // cpu_irq_wrapper: Handle (external) interrupt exception
 //-----------------------------------------------------------------
 static CRITICALFUNC struct irq_context * cpu_irq_wrapper(struct irq_context *ctx)
 {
+    struct thread* thread;
+
     OS_ASSERT(_platform_irq_cb);
 
     // Check that this not occuring recursively!
     OS_ASSERT(!_in_interrupt);
     _in_interrupt = 1;
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_enter(cpu_irq_source());
+#endif
     ctx = _platform_irq_cb(ctx);
+
+    // Handler woke a thread (or queued a kernel request), run the
+    // scheduler now rather than waiting for the next tick
+    thread = thread_current();
+    if (_irq_switch && thread)
+    {
+        _irq_switch = 0;
+
+        thread->tcb.ctx = ctx;
+
+        // Load new thread context
+        thread_load_context(1);
+
+        // Get stack frame of new thread
+        thread = thread_current();
+        ctx = (uint32_t *)thread->tcb.ctx;
+
+        // Try and detect stack overflow
+        OS_ASSERT(thread->tcb.stack_alloc[0] == STACK_CHK_BYTE);
+    }
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    thread_irq_exit();
+#endif
     _in_interrupt = 0;
 
     return ctx;
 }
+#ifdef CONFIG_RTOS_HRTIMER
+//-----------------------------------------------------------------
+// cpu_hrtimer_set: Arm one-shot timer for a cpu_timenow() value
+// (0 = disarm). Shares mtimecmp with the tick, which is programmed with
+// whichever is due first.
+// NOTE: Assumes the cycle counter and mtime both run at MCU_CLK
+//-----------------------------------------------------------------
+CRITICALFUNC void cpu_hrtimer_set(uint64_t wake_time)
+{
+    uint64_t due = _tick_due;
+    uint64_t hr_due;
+    int64_t delta;
+
+    if (wake_time)
+    {
+        delta = cpu_timediff(wake_time, cpu_timenow());
+        hr_due = timer_get_mtime() + (delta > 0 ? delta : 0);
+
+        if ((int64_t)(hr_due - due) < 0)
+            due = hr_due;
+    }
+
+    timer_set_mtimecmp(due);
+}
+#endif
 //-----------------------------------------------------------------
 // cpu_thread_start:
 //-----------------------------------------------------------------
@@ -231,7 +464,12 @@ void cpu_thread_start( void )
     csr_clr_irq_enable();
 
     // Enable timer IRQ source (global IRQ still disabled)
+#ifdef CONFIG_RTOS_HRTIMER
+    _tick_due = timer_get_mtime() + (MCU_CLK/TICK_RATE_HZ);
+    timer_set_mtimecmp(_tick_due);
+#else
     timer_set_mtimecmp(timer_get_mtime() + (MCU_CLK/TICK_RATE_HZ));
+#endif
     csr_set(mie, SR_IP_MTIP);
 
     // Run the scheduler to pick the highest prio thread
@@ -313,6 +551,33 @@ WEAK void cpu_idle(void)
 {
     // Do nothing
 }
+//-----------------------------------------------------------------
+// cpu_timenow: 64-bit cycle counter
+//-----------------------------------------------------------------
+WEAK uint64_t NO_PROFILE cpu_timenow(void)
+{
+    uint32_t hi;
+    uint32_t lo;
+    uint32_t hi2;
+
+    // Re-read if the upper word changed while reading the lower word
+    do
+    {
+        asm volatile ("rdcycleh %0" : "=r" (hi));
+        asm volatile ("rdcycle %0"  : "=r" (lo));
+        asm volatile ("rdcycleh %0" : "=r" (hi2));
+    }
+    while (hi != hi2);
+
+    return ((uint64_t)hi << 32) | lo;
+}
+//-----------------------------------------------------------------
+// cpu_timediff: Difference between two cpu_timenow() values (a - b)
+//-----------------------------------------------------------------
+WEAK int64_t NO_PROFILE cpu_timediff(uint64_t a, uint64_t b)
+{
+    return (int64_t)(a - b);
+}
 #ifdef INCLUDE_TEST_MAIN
 //-----------------------------------------------------------------
 // main:
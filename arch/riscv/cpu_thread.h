@@ -13,6 +13,47 @@
     #define CRITICALFUNC
 #endif
 
+// cpu_timenow is in MCU_CLK cycles: wake latency histogram bucket 0 ends
+// at 1-2us (2^(shift+1) >= cycles per us)
+#if defined(MCU_CLK) && !defined(CPU_WAKE_HIST_SHIFT)
+    #if MCU_CLK > 256000000
+        #define CPU_WAKE_HIST_SHIFT 8
+    #elif MCU_CLK > 128000000
+        #define CPU_WAKE_HIST_SHIFT 7
+    #elif MCU_CLK > 64000000
+        #define CPU_WAKE_HIST_SHIFT 6
+    #elif MCU_CLK > 32000000
+        #define CPU_WAKE_HIST_SHIFT 5
+    #elif MCU_CLK > 16000000
+        #define CPU_WAKE_HIST_SHIFT 4
+    #elif MCU_CLK > 8000000
+        #define CPU_WAKE_HIST_SHIFT 3
+    #elif MCU_CLK > 4000000
+        #define CPU_WAKE_HIST_SHIFT 2
+    #elif MCU_CLK > 2000000
+        #define CPU_WAKE_HIST_SHIFT 1
+    #else
+        #define CPU_WAKE_HIST_SHIFT 0
+    #endif
+#endif
+
+#ifdef CONFIG_RTOS_PC_SAMPLING
+// Default sampling rate (take a PC sample every N ticks, 0 = off)
+#ifndef CPU_PC_SAMPLE_RATE
+    #define CPU_PC_SAMPLE_RATE      1
+#endif
+
+// Number of distinct (thread, PC) pairs which can be recorded (power of 2)
+#ifndef CPU_PC_SAMPLE_ENTRIES
+    #define CPU_PC_SAMPLE_ENTRIES   1024
+#endif
+
+// Max hash probes before a new (thread, PC) pair is dropped
+#ifndef CPU_PC_SAMPLE_PROBES
+    #define CPU_PC_SAMPLE_PROBES    8
+#endif
+#endif
+
 //-----------------------------------------------------------------
 // Structures
 //-----------------------------------------------------------------
@@ -34,6 +75,16 @@ struct cpu_tcb
 
 typedef uint32_t stk_t;
 
+#ifdef CONFIG_RTOS_PC_SAMPLING
+// PC sample histogram entry (count = 0 for an unused entry)
+struct cpu_pc_sample
+{
+    uint32_t  pc;
+    int       thread_id;
+    uint32_t  count;
+};
+#endif
+
 //-----------------------------------------------------------------
 // Prototypes
 //-----------------------------------------------------------------
@@ -67,6 +118,28 @@ int     cpu_thread_stack_size(struct cpu_tcb * pCurrent);
 uint64_t cpu_timenow(void);
 int64_t  cpu_timediff(uint64_t a, uint64_t b);
 
+#ifdef CONFIG_RTOS_HRTIMER
+// Arm one-shot timer for cpu_timenow() value wake_time (0 = disarm),
+// expiry calls thread_hrtimer_irq then thread_load_context
+void     cpu_hrtimer_set(uint64_t wake_time);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+// Interrupt time accounting source of the pending external interrupt.
+// Weak default returns THREAD_IRQ_EXT; platforms override to decode
+// the source (without acknowledging it) so that each device's time is
+// accounted separately.
+int     cpu_irq_source(void);
+#endif
+
+#ifdef CONFIG_RTOS_PC_SAMPLING
+// PC sampling profiler: set rate (ticks per sample, 0 = off), clear
+// histogram and dump as CSV for tools/pcprof.py
+void    cpu_pc_sample_rate(int ticks);
+void    cpu_pc_sample_reset(void);
+void    cpu_pc_sample_dump(int (*os_printf)(const char* ctrl1, ... ));
+#endif
+
 // System specific assert handling function
 void    cpu_thread_assert(const char *reason, const char *file, int line);
 
@@ -13,6 +13,10 @@
     #define CRITICALFUNC
 #endif
 
+// Optional: Wake latency histogram shift so bucket 0 ends at about 1us of
+// cpu_timenow() units (CONFIG_RTOS_MEASURE_WAKE_LATENCY)
+// #define CPU_WAKE_HIST_SHIFT     0
+
 //-----------------------------------------------------------------
 // Structures
 //-----------------------------------------------------------------
@@ -47,7 +51,7 @@ void    cpu_thread_start(void);
 // Force context switch
 void    cpu_context_switch(void);
 
-// Force context switch (from IRQ)
+// Force context switch (from IRQ, taken on interrupt exit)
 void    cpu_context_switch_irq(void);
 
 // Critical section entry & exit
@@ -67,6 +71,16 @@ int     cpu_thread_stack_size(struct cpu_tcb * pCurrent);
 uint64_t cpu_timenow(void);
 int64_t  cpu_timediff(uint64_t a, uint64_t b);
 
+// Optional: High resolution sleeps (CONFIG_RTOS_HRTIMER), arm a one-shot
+// timer for cpu_timenow() value wake_time (0 = disarm). On expiry call
+// thread_hrtimer_irq() then thread_load_context(1).
+// void    cpu_hrtimer_set(uint64_t wake_time);
+
+// Optional: Per-thread performance counters, define CPU_THREAD_PERF_COUNTERS
+// and add 'uint64_t perf[CPU_THREAD_PERF_COUNTERS]' to struct cpu_tcb
+// void    cpu_perf_update(struct cpu_tcb *tcb);
+// const char * cpu_perf_name(int idx);
+
 // System specific assert handling function
 void    cpu_thread_assert(const char *reason, const char *file, int line);
 
@@ -0,0 +1,185 @@
+#include "api_stats.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef CONFIG_RTOS_API_STATS
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct api_stats     _api_stats[API_STATS_COUNT];
+
+static const char *         _api_stats_names[API_STATS_COUNT] =
+{
+    "thread_init",
+    "thread_kill",
+    "thread_join",
+    "thread_sleep",
+    "thread_sleep_thread",
+    "thread_sleep_cancel",
+    "thread_tick",
+    "thread_load_context",
+    "thread_block",
+    "thread_unblock",
+    "thread_unblock_irq",
+    "thread_set_priority",
+    "thread_sleep_until",
+    "thread_wait_next_period",
+    "thread_sleep_slack",
+    "thread_sleep_hr",
+    "semaphore_pend",
+    "semaphore_post",
+    "semaphore_post_irq",
+    "semaphore_try",
+    "semaphore_timed_pend",
+    "semaphore_timed_pend_slack",
+    "semaphore_timed_pend_hr",
+    "mutex_lock",
+    "mutex_trylock",
+    "mutex_unlock",
+    "mailbox_post",
+    "mailbox_pend",
+    "mailbox_pend_timed",
+    "event_set",
+    "event_get",
+    "cpu_tick",
+    "cpu_context_switch"
+};
+
+//-----------------------------------------------------------------
+// api_stats_begin: Start measuring a kernel API call
+//-----------------------------------------------------------------
+CRITICALFUNC struct api_stats_timer api_stats_begin(void)
+{
+    struct api_stats_timer timer;
+
+    timer.thread   = thread_current();
+    timer.switched = timer.thread ? timer.thread->api_switched : 0;
+    timer.start    = cpu_timenow();
+
+    return timer;
+}
+//-----------------------------------------------------------------
+// api_stats_end: Record execution time of a kernel API call
+//-----------------------------------------------------------------
+CRITICALFUNC void api_stats_end(tApiStatsId id, struct api_stats_timer *timer)
+{
+    struct api_stats *stats;
+    int64_t  delta = cpu_timediff(cpu_timenow(), timer->start);
+    uint32_t elapsed;
+    uint32_t v;
+    int bucket = 0;
+    int cr;
+
+    OS_ASSERT(id < API_STATS_COUNT);
+
+    // Remove time the calling thread spent switched out
+    if (timer->thread)
+        delta -= (int64_t)(timer->thread->api_switched - timer->switched);
+
+    if (delta < 0)
+        delta = 0;
+    else if (delta > 0xFFFFFFFF)
+        delta = 0xFFFFFFFF;
+
+    elapsed = (uint32_t)delta;
+
+    // Bucket N holds times below 2^(N+1) (and >= 2^N for N > 0)
+    v = elapsed >> API_STATS_HIST_SHIFT;
+    while (v > 1 && bucket < (API_STATS_HIST_BUCKETS - 1))
+    {
+        v >>= 1;
+        bucket++;
+    }
+
+    cr = critical_start();
+
+    stats = &_api_stats[id];
+
+    if (stats->count == 0 || elapsed < stats->min)
+        stats->min = elapsed;
+    if (elapsed > stats->max)
+        stats->max = elapsed;
+
+    stats->count++;
+    stats->total += elapsed;
+    stats->hist[bucket]++;
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// api_stats_reset: Clear all measurements
+//-----------------------------------------------------------------
+void api_stats_reset(void)
+{
+    int i;
+    int b;
+    int cr = critical_start();
+
+    for (i=0;i<API_STATS_COUNT;i++)
+    {
+        _api_stats[i].count = 0;
+        _api_stats[i].min = 0;
+        _api_stats[i].max = 0;
+        _api_stats[i].total = 0;
+
+        for (b=0;b<API_STATS_HIST_BUCKETS;b++)
+            _api_stats[i].hist[b] = 0;
+    }
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// api_stats_get: Copy measurements for an API
+//-----------------------------------------------------------------
+int api_stats_get(tApiStatsId id, struct api_stats *stats)
+{
+    int cr;
+
+    if (id >= API_STATS_COUNT || !stats)
+        return 0;
+
+    cr = critical_start();
+    *stats = _api_stats[id];
+    critical_end(cr);
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// api_stats_name: Name of an API
+//-----------------------------------------------------------------
+const char * api_stats_name(tApiStatsId id)
+{
+    if (id >= API_STATS_COUNT)
+        return "unknown";
+
+    return _api_stats_names[id];
+}
+//-----------------------------------------------------------------
+// api_stats_dump_csv: Dump all measurements as CSV
+// (one row per API: name,count,min,max,avg,hist0..histN)
+//-----------------------------------------------------------------
+void api_stats_dump_csv(int (*os_printf)(const char* ctrl1, ... ))
+{
+    struct api_stats stats;
+    int i;
+    int b;
+
+    os_printf("api,count,min,max,avg");
+    for (b=0;b<API_STATS_HIST_BUCKETS;b++)
+        os_printf(",h%d", b);
+    os_printf("\r\n");
+
+    for (i=0;i<API_STATS_COUNT;i++)
+    {
+        // Take a copy so the row is consistent
+        api_stats_get((tApiStatsId)i, &stats);
+
+        os_printf("%s,%ld,%ld,%ld,%ld", _api_stats_names[i], stats.count, stats.min, stats.max,
+                  stats.count ? (uint32_t)(stats.total / stats.count) : 0);
+
+        for (b=0;b<API_STATS_HIST_BUCKETS;b++)
+            os_printf(",%ld", stats.hist[b]);
+        os_printf("\r\n");
+    }
+}
+#endif
@@ -0,0 +1,123 @@
+#ifndef __API_STATS_H__
+#define __API_STATS_H__
+
+#include "thread.h"
+
+// To enable kernel API execution time measurement define
+// CONFIG_RTOS_API_STATS (requires cpu_timenow / cpu_timediff).
+// Time a calling thread spends switched out (blocked, sleeping or
+// preempted inside the call by the tick or an interrupt) is excluded
+// from the measurement. Interrupt handling which returns to the
+// calling thread without a switch is still included.
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+
+// Number of log2 buckets in each histogram
+#ifndef API_STATS_HIST_BUCKETS
+    #define API_STATS_HIST_BUCKETS  16
+#endif
+
+// Execution time (cpu_timenow units) is shifted right by this before bucketing
+#ifndef API_STATS_HIST_SHIFT
+    #define API_STATS_HIST_SHIFT    0
+#endif
+
+//-----------------------------------------------------------------
+// Enums
+//-----------------------------------------------------------------
+typedef enum eApiStatsId
+{
+    API_STATS_THREAD_INIT,
+    API_STATS_THREAD_KILL,
+    API_STATS_THREAD_JOIN,
+    API_STATS_THREAD_SLEEP,
+    API_STATS_THREAD_SLEEP_THREAD,
+    API_STATS_THREAD_SLEEP_CANCEL,
+    API_STATS_THREAD_TICK,
+    API_STATS_THREAD_LOAD_CONTEXT,
+    API_STATS_THREAD_BLOCK,
+    API_STATS_THREAD_UNBLOCK,
+    API_STATS_THREAD_UNBLOCK_IRQ,
+    API_STATS_THREAD_SET_PRIORITY,
+    API_STATS_THREAD_SLEEP_UNTIL,
+    API_STATS_THREAD_WAIT_NEXT_PERIOD,
+    API_STATS_THREAD_SLEEP_SLACK,
+    API_STATS_THREAD_SLEEP_HR,
+    API_STATS_SEMAPHORE_PEND,
+    API_STATS_SEMAPHORE_POST,
+    API_STATS_SEMAPHORE_POST_IRQ,
+    API_STATS_SEMAPHORE_TRY,
+    API_STATS_SEMAPHORE_TIMED_PEND,
+    API_STATS_SEMAPHORE_TIMED_PEND_SLACK,
+    API_STATS_SEMAPHORE_TIMED_PEND_HR,
+    API_STATS_MUTEX_LOCK,
+    API_STATS_MUTEX_TRYLOCK,
+    API_STATS_MUTEX_UNLOCK,
+    API_STATS_MAILBOX_POST,
+    API_STATS_MAILBOX_PEND,
+    API_STATS_MAILBOX_PEND_TIMED,
+    API_STATS_EVENT_SET,
+    API_STATS_EVENT_GET,
+    API_STATS_CPU_TICK,
+    API_STATS_CPU_CONTEXT_SWITCH,
+    API_STATS_COUNT
+} tApiStatsId;
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct api_stats
+{
+    uint32_t            count;
+    uint32_t            min;
+    uint32_t            max;
+    uint64_t            total;
+    uint32_t            hist[API_STATS_HIST_BUCKETS];
+};
+
+// Measurement in progress (on the caller's stack)
+struct api_stats_timer
+{
+    struct thread      *thread;
+    uint64_t            start;
+    uint64_t            switched;
+};
+
+//-----------------------------------------------------------------
+// Hooks
+// NOTE: API_STATS_BEGIN is a declaration, place after local variables
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_API_STATS
+    #define API_STATS_BEGIN()       struct api_stats_timer _api_timer = api_stats_begin()
+    #define API_STATS_END(id)       api_stats_end(id, &_api_timer)
+#else
+    #define API_STATS_BEGIN()
+    #define API_STATS_END(id)       do { } while (0)
+#endif
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_API_STATS
+
+// Clear all measurements
+void                    api_stats_reset(void);
+
+// Copy measurements for an API (returns 1 if valid id)
+int                     api_stats_get(tApiStatsId id, struct api_stats *stats);
+
+// Name of an API
+const char *            api_stats_name(tApiStatsId id);
+
+// Dump all measurements as CSV
+void                    api_stats_dump_csv(int (*os_printf)(const char* ctrl1, ... ));
+
+// Measurement hooks
+struct api_stats_timer  api_stats_begin(void);
+void                    api_stats_end(tApiStatsId id, struct api_stats_timer *timer);
+
+#endif
+
+#endif
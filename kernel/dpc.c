@@ -0,0 +1,198 @@
+#include "dpc.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef INCLUDE_DPC
+
+#if (DPC_ENTRIES & (DPC_ENTRIES - 1)) != 0
+    #error "DPC_ENTRIES must be a power of 2"
+#endif
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct dpc_entry     _dpc_ring[DPC_ENTRIES];
+
+// Producers (interrupts do not nest, thread callers use a critical
+// section) advance head, the DPC thread advances tail
+static volatile uint32_t    _dpc_head;
+static volatile uint32_t    _dpc_tail;
+
+// DPC thread blocked waiting for work
+static volatile int         _dpc_waiting;
+
+static struct dpc_stats     _dpc_stats;
+static struct thread        _dpc_thread;
+static stk_t                _dpc_thread_stack[DPC_THREAD_STACK];
+
+//-----------------------------------------------------------------
+// dpc_enqueue: Add an entry to the queue (single producer at a time)
+// Returns: 1 if queued, 0 if the queue is full
+//-----------------------------------------------------------------
+static int dpc_enqueue(void (*func)(void *arg), void *arg)
+{
+    volatile struct dpc_entry *entry;
+    uint32_t idx = _dpc_head;
+    uint32_t depth = idx - _dpc_tail;
+
+    if (depth >= DPC_ENTRIES)
+    {
+        _dpc_stats.overflows++;
+        return 0;
+    }
+
+    entry = &_dpc_ring[idx & (DPC_ENTRIES - 1)];
+    entry->func = func;
+    entry->arg = arg;
+    entry->queued = cpu_timenow();
+
+    // Publish the entry to the DPC thread
+    _dpc_head = idx + 1;
+
+    _dpc_stats.queued++;
+    if (depth + 1 > _dpc_stats.depth_max)
+        _dpc_stats.depth_max = depth + 1;
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// dpc_run_one: Run the oldest queued entry
+// Returns: 1 if an entry was run, 0 if the queue is empty
+//-----------------------------------------------------------------
+static int dpc_run_one(void)
+{
+    volatile struct dpc_entry *entry;
+    void (*func)(void *arg);
+    void *arg;
+    int64_t latency;
+    uint32_t idx = _dpc_tail;
+
+    if (idx == _dpc_head)
+        return 0;
+
+    entry = &_dpc_ring[idx & (DPC_ENTRIES - 1)];
+    func = entry->func;
+    arg = entry->arg;
+
+    latency = cpu_timediff(cpu_timenow(), entry->queued);
+    if (latency < 0)
+        latency = 0;
+
+    // Release the entry back to the producers
+    _dpc_tail = idx + 1;
+
+    _dpc_stats.executed++;
+    _dpc_stats.latency_total += (uint64_t)latency;
+    if ((uint64_t)latency > _dpc_stats.latency_max)
+        _dpc_stats.latency_max = (uint32_t)latency;
+
+    func(arg);
+    return 1;
+}
+//-----------------------------------------------------------------
+// dpc_thread_func: Run everything queued, then wait for more
+//-----------------------------------------------------------------
+static void *dpc_thread_func(void *arg)
+{
+    int cr;
+
+    while (1)
+    {
+        while (dpc_run_one())
+            ;
+
+        cr = critical_start();
+
+        // Nothing queued since the last pass, wait for a producer
+        if (_dpc_head == _dpc_tail)
+        {
+            _dpc_waiting = 1;
+            thread_block(&_dpc_thread);
+        }
+
+        critical_end(cr);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// dpc_init: Initialise DPC queue and start the DPC thread
+//-----------------------------------------------------------------
+void dpc_init(void)
+{
+    _dpc_head = 0;
+    _dpc_tail = 0;
+
+    _dpc_stats.queued = 0;
+    _dpc_stats.executed = 0;
+    _dpc_stats.overflows = 0;
+    _dpc_stats.depth_max = 0;
+    _dpc_stats.latency_max = 0;
+    _dpc_stats.latency_total = 0;
+
+    // Start waiting for work
+    _dpc_waiting = 1;
+    thread_init_ex(&_dpc_thread, "DPC", THREAD_INT_PRIO, dpc_thread_func, NULL, _dpc_thread_stack, DPC_THREAD_STACK, THREAD_BLOCKED);
+}
+//-----------------------------------------------------------------
+// dpc_queue_irq: Queue a call from interrupt context.
+// Never blocks or takes a lock; if the queue is full the call is
+// dropped and counted.
+// Returns: 1 if queued, 0 if the queue is full
+//-----------------------------------------------------------------
+int dpc_queue_irq(void (*func)(void *arg), void *arg)
+{
+    OS_ASSERT(func != NULL);
+
+    if (!dpc_enqueue(func, arg))
+        return 0;
+
+    // Wake the DPC thread, which runs once the interrupt completes
+    if (_dpc_waiting)
+    {
+        _dpc_waiting = 0;
+        thread_unblock_irq(&_dpc_thread);
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// dpc_queue: Queue a call from thread context. The call runs before
+// this function returns unless the scheduler is locked.
+// Returns: 1 if queued, 0 if the queue is full
+//-----------------------------------------------------------------
+int dpc_queue(void (*func)(void *arg), void *arg)
+{
+    int ok;
+    int cr;
+
+    OS_ASSERT(func != NULL);
+
+    // Serialise with interrupt context producers
+    cr = critical_start();
+
+    ok = dpc_enqueue(func, arg);
+    if (ok && _dpc_waiting)
+    {
+        _dpc_waiting = 0;
+        thread_unblock(&_dpc_thread);
+    }
+
+    critical_end(cr);
+
+    return ok;
+}
+//-----------------------------------------------------------------
+// dpc_get_stats: Get queue statistics
+//-----------------------------------------------------------------
+void dpc_get_stats(struct dpc_stats *stats)
+{
+    int cr;
+
+    OS_ASSERT(stats != NULL);
+
+    cr = critical_start();
+    *stats = _dpc_stats;
+    critical_end(cr);
+}
+#endif
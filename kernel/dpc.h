@@ -0,0 +1,70 @@
+#ifndef __DPC_H__
+#define __DPC_H__
+
+#include "thread.h"
+
+// Deferred procedure calls (ISR bottom halves).
+// Interrupt handlers queue a function + argument without allocating or
+// taking locks; a kernel thread at THREAD_INT_PRIO runs everything
+// queued in one pass before any normal priority thread runs.
+// DPC functions run in thread context but must not block.
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+
+// Number of queue entries (must be a power of 2)
+#ifndef DPC_ENTRIES
+    #define DPC_ENTRIES         32
+#endif
+
+// DPC thread stack size
+#ifndef DPC_THREAD_STACK
+    #define DPC_THREAD_STACK    1024
+#endif
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct dpc_entry
+{
+    void                (*func)(void *arg);
+    void                *arg;
+
+    // cpu_timenow() when queued
+    uint64_t            queued;
+};
+
+struct dpc_stats
+{
+    uint32_t            queued;
+    uint32_t            executed;
+
+    // Calls dropped due to a full queue
+    uint32_t            overflows;
+
+    // Queue depth high water mark
+    uint32_t            depth_max;
+
+    // Queue to start of execution latency (cpu_timenow units)
+    uint32_t            latency_max;
+    uint64_t            latency_total;
+};
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+
+// Initialise DPC queue and start the DPC thread
+void        dpc_init(void);
+
+// Queue a call from interrupt context (returns 0 if the queue is full)
+int         dpc_queue_irq(void (*func)(void *arg), void *arg);
+
+// Queue a call from thread context (returns 0 if the queue is full)
+int         dpc_queue(void (*func)(void *arg), void *arg);
+
+// Get queue statistics
+void        dpc_get_stats(struct dpc_stats *stats);
+
+#endif
@@ -1,6 +1,7 @@
 #include "event.h"
 #include "critical.h"
 #include "os_assert.h"
+#include "api_stats.h"
 
 #ifdef INCLUDE_EVENTS
 
@@ -21,20 +22,22 @@ uint32_t event_get(struct event *ev)
 {
     uint32_t value = 0;
     int cr;
+    API_STATS_BEGIN();
 
     OS_ASSERT(ev != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
-    // Wait for semaphore (it is safe to do this in a critical section)
+    // Wait for semaphore (it is safe to block with the lock held)
     semaphore_pend(&ev->sema);
 
     // Retrieve event value & reset
     value = ev->value;
     ev->value = 0;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_EVENT_GET);
     return value;
 }
 //-----------------------------------------------------------------
@@ -43,11 +46,12 @@ uint32_t event_get(struct event *ev)
 void event_set(struct event *ev, uint32_t value)
 {
     int cr;
+    API_STATS_BEGIN();
 
     OS_ASSERT(ev != NULL);
     OS_ASSERT(value);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Already pending event
     if (ev->value != 0)
@@ -64,7 +68,9 @@ void event_set(struct event *ev, uint32_t value)
         semaphore_post(&ev->sema);
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_EVENT_SET);
 }
 
 #endif
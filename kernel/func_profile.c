@@ -0,0 +1,331 @@
+#include "func_profile.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+
+#if (FUNC_PROFILE_FUNCS & (FUNC_PROFILE_FUNCS - 1)) != 0
+    #error "FUNC_PROFILE_FUNCS must be a power of 2"
+#endif
+
+#if (FUNC_PROFILE_EDGES & (FUNC_PROFILE_EDGES - 1)) != 0
+    #error "FUNC_PROFILE_EDGES must be a power of 2"
+#endif
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define NO_INSTRUMENT           __attribute__((__no_instrument_function__))
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct func_profile_func _prof_funcs[FUNC_PROFILE_FUNCS];
+static struct func_profile_edge _prof_edges[FUNC_PROFILE_EDGES];
+
+// Hook re-entered (e.g. from an instrumented interrupt handler)
+static int                  _prof_busy;
+static uint32_t             _prof_missed;
+
+// Exit without a matching entry, calls deeper than the shadow stack,
+// functions / edges not recorded due to full tables
+static uint32_t             _prof_unmatched;
+static uint32_t             _prof_overflow;
+static uint32_t             _prof_dropped;
+
+//-----------------------------------------------------------------
+// func_profile_hash: Hash a function address
+//-----------------------------------------------------------------
+static NO_INSTRUMENT uint32_t func_profile_hash(void *p)
+{
+    return (uint32_t)((unsigned long)p >> 1) * 0x9E3779B1;
+}
+//-----------------------------------------------------------------
+// func_profile_now: Thread virtual time (excludes time switched out)
+//-----------------------------------------------------------------
+static NO_INSTRUMENT uint64_t func_profile_now(struct thread *pThread)
+{
+    return cpu_timenow() - pThread->prof_switched;
+}
+//-----------------------------------------------------------------
+// func_profile_record: Add a completed call to the function table
+//-----------------------------------------------------------------
+static NO_INSTRUMENT void func_profile_record(void *func, uint64_t inclusive, uint64_t exclusive, int recursive)
+{
+    struct func_profile_func *entry;
+    uint32_t idx = func_profile_hash(func);
+    int i;
+
+    for (i=0;i<FUNC_PROFILE_PROBES;i++)
+    {
+        entry = &_prof_funcs[(idx + i) & (FUNC_PROFILE_FUNCS - 1)];
+
+        if (entry->calls == 0)
+            entry->func = func;
+        else if (entry->func != func)
+            continue;
+
+        entry->calls++;
+        entry->exclusive += exclusive;
+
+        // Inclusive time of a recursive call is already part of the
+        // outer invocation's inclusive time
+        if (!recursive)
+            entry->inclusive += inclusive;
+        return;
+    }
+
+    _prof_dropped++;
+}
+//-----------------------------------------------------------------
+// func_profile_record_edge: Add a completed call to the edge table
+//-----------------------------------------------------------------
+static NO_INSTRUMENT void func_profile_record_edge(void *caller, void *callee, uint64_t inclusive)
+{
+    struct func_profile_edge *entry;
+    uint32_t idx = func_profile_hash(callee) ^ (func_profile_hash(caller) >> 3);
+    int i;
+
+    for (i=0;i<FUNC_PROFILE_PROBES;i++)
+    {
+        entry = &_prof_edges[(idx + i) & (FUNC_PROFILE_EDGES - 1)];
+
+        if (entry->calls == 0)
+        {
+            entry->caller = caller;
+            entry->callee = callee;
+        }
+        else if (entry->caller != caller || entry->callee != callee)
+            continue;
+
+        entry->calls++;
+        entry->inclusive += inclusive;
+        return;
+    }
+
+    _prof_dropped++;
+}
+//-----------------------------------------------------------------
+// func_profile_pop: Complete the top frame of a thread's shadow stack
+//-----------------------------------------------------------------
+static NO_INSTRUMENT void func_profile_pop(struct thread *pThread, uint64_t now)
+{
+    struct func_profile_frame *frame = &pThread->prof_stack[--pThread->prof_depth];
+    uint64_t inclusive = now - frame->enter;
+    uint64_t exclusive = inclusive > frame->child ? inclusive - frame->child : 0;
+    void *caller = NULL;
+    int recursive = 0;
+    int i;
+
+    for (i=0;i<pThread->prof_depth;i++)
+        if (pThread->prof_stack[i].func == frame->func)
+        {
+            recursive = 1;
+            break;
+        }
+
+    func_profile_record(frame->func, inclusive, exclusive, recursive);
+
+    if (pThread->prof_depth > 0)
+    {
+        caller = pThread->prof_stack[pThread->prof_depth - 1].func;
+        pThread->prof_stack[pThread->prof_depth - 1].child += inclusive;
+    }
+
+    func_profile_record_edge(caller, frame->func, inclusive);
+}
+//-----------------------------------------------------------------
+// __cyg_profile_func_enter: Instrumented function entry
+//-----------------------------------------------------------------
+void NO_INSTRUMENT __cyg_profile_func_enter(void *this_fn, void *call_site)
+{
+    struct thread *pThread;
+    struct func_profile_frame *frame;
+    int cr = critical_start();
+
+    if (_prof_busy)
+    {
+        _prof_missed++;
+        critical_end(cr);
+        return;
+    }
+    _prof_busy = 1;
+
+    // Calls before the kernel has started are not profiled
+    pThread = thread_current();
+    if (pThread)
+    {
+        if (pThread->prof_depth < THREAD_FUNC_PROFILE_DEPTH)
+        {
+            frame = &pThread->prof_stack[pThread->prof_depth];
+            frame->func  = this_fn;
+            frame->child = 0;
+            frame->enter = func_profile_now(pThread);
+        }
+        else
+            _prof_overflow++;
+
+        pThread->prof_depth++;
+    }
+
+    _prof_busy = 0;
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// __cyg_profile_func_exit: Instrumented function exit.
+// Frames above the matching entry (functions which never returned
+// normally, e.g. longjmp) are completed at the same time.
+//-----------------------------------------------------------------
+void NO_INSTRUMENT __cyg_profile_func_exit(void *this_fn, void *call_site)
+{
+    struct thread *pThread;
+    uint64_t now;
+    int i;
+    int cr = critical_start();
+
+    if (_prof_busy)
+    {
+        _prof_missed++;
+        critical_end(cr);
+        return;
+    }
+    _prof_busy = 1;
+
+    // Calls before the kernel has started are not profiled
+    pThread = thread_current();
+    if (pThread && pThread->prof_depth > THREAD_FUNC_PROFILE_DEPTH)
+    {
+        // Frame was never recorded
+        pThread->prof_depth--;
+    }
+    else if (pThread)
+    {
+        now = func_profile_now(pThread);
+
+        // Find the matching entry
+        for (i=pThread->prof_depth-1;i>=0;i--)
+            if (pThread->prof_stack[i].func == this_fn)
+                break;
+
+        if (i < 0)
+            _prof_unmatched++;
+        else
+        {
+            while (pThread->prof_depth > i)
+                func_profile_pop(pThread, now);
+        }
+    }
+
+    _prof_busy = 0;
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// func_profile_switch: Thread switch - stop the outgoing thread's
+// virtual clock and restart the incoming thread's.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+CRITICALFUNC void NO_INSTRUMENT func_profile_switch(struct thread *from, struct thread *to)
+{
+    uint64_t now = cpu_timenow();
+
+    if (from)
+        from->prof_switch_out = now;
+
+    if (to && to->prof_switch_out)
+    {
+        to->prof_switched += now - to->prof_switch_out;
+        to->prof_switch_out = 0;
+    }
+}
+//-----------------------------------------------------------------
+// func_profile_reset: Clear all measurements
+//-----------------------------------------------------------------
+void func_profile_reset(void)
+{
+    int i;
+    int cr = critical_start();
+
+    for (i=0;i<FUNC_PROFILE_FUNCS;i++)
+    {
+        _prof_funcs[i].func = NULL;
+        _prof_funcs[i].calls = 0;
+        _prof_funcs[i].inclusive = 0;
+        _prof_funcs[i].exclusive = 0;
+    }
+
+    for (i=0;i<FUNC_PROFILE_EDGES;i++)
+    {
+        _prof_edges[i].caller = NULL;
+        _prof_edges[i].callee = NULL;
+        _prof_edges[i].calls = 0;
+        _prof_edges[i].inclusive = 0;
+    }
+
+    _prof_missed = 0;
+    _prof_unmatched = 0;
+    _prof_overflow = 0;
+    _prof_dropped = 0;
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// func_profile_get_func: Copy function totals (returns 0 if unused)
+//-----------------------------------------------------------------
+int func_profile_get_func(int idx, struct func_profile_func *func)
+{
+    int cr;
+
+    OS_ASSERT(func != NULL);
+
+    if (idx < 0 || idx >= FUNC_PROFILE_FUNCS)
+        return 0;
+
+    cr = critical_start();
+    *func = _prof_funcs[idx];
+    critical_end(cr);
+
+    return func->calls != 0;
+}
+//-----------------------------------------------------------------
+// func_profile_get_edge: Copy edge totals (returns 0 if unused)
+//-----------------------------------------------------------------
+int func_profile_get_edge(int idx, struct func_profile_edge *edge)
+{
+    int cr;
+
+    OS_ASSERT(edge != NULL);
+
+    if (idx < 0 || idx >= FUNC_PROFILE_EDGES)
+        return 0;
+
+    cr = critical_start();
+    *edge = _prof_edges[idx];
+    critical_end(cr);
+
+    return edge->calls != 0;
+}
+//-----------------------------------------------------------------
+// func_profile_dump: Dump functions and call graph edges as CSV
+// F,func,calls,inclusive,exclusive
+// E,caller,callee,calls,inclusive
+//-----------------------------------------------------------------
+void func_profile_dump(int (*os_printf)(const char* ctrl1, ... ))
+{
+    struct func_profile_func func;
+    struct func_profile_edge edge;
+    int i;
+
+    os_printf("# funcprof missed=%ld unmatched=%ld overflow=%ld dropped=%ld\r\n",
+              _prof_missed, _prof_unmatched, _prof_overflow, _prof_dropped);
+
+    for (i=0;i<FUNC_PROFILE_FUNCS;i++)
+        if (func_profile_get_func(i, &func))
+            os_printf("F,%p,%ld,%llu,%llu\r\n", func.func, func.calls,
+                      (unsigned long long)func.inclusive, (unsigned long long)func.exclusive);
+
+    for (i=0;i<FUNC_PROFILE_EDGES;i++)
+        if (func_profile_get_edge(i, &edge))
+            os_printf("E,%p,%p,%ld,%llu\r\n", edge.caller, edge.callee, edge.calls,
+                      (unsigned long long)edge.inclusive);
+}
+#endif
@@ -0,0 +1,89 @@
+#ifndef __FUNC_PROFILE_H__
+#define __FUNC_PROFILE_H__
+
+#include "thread.h"
+
+// Function level profiler using gcc -finstrument-functions.
+// To enable define CONFIG_RTOS_FUNC_PROFILE (requires cpu_timenow) and
+// build the application code of interest with -finstrument-functions.
+// The kernel and port must NOT be instrumented, e.g. use
+//   -finstrument-functions-exclude-file-list=kernel/,arch/
+// Each thread keeps a shadow call stack and a virtual clock which stops
+// while the thread is switched out, so times are per-thread CPU time
+// (interrupts are charged to the function they interrupted).
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+
+// Max number of distinct functions recorded (power of 2)
+#ifndef FUNC_PROFILE_FUNCS
+    #define FUNC_PROFILE_FUNCS      256
+#endif
+
+// Max number of distinct caller -> callee edges recorded (power of 2)
+#ifndef FUNC_PROFILE_EDGES
+    #define FUNC_PROFILE_EDGES      512
+#endif
+
+// Max hash probes before a new function / edge is dropped
+#ifndef FUNC_PROFILE_PROBES
+    #define FUNC_PROFILE_PROBES     8
+#endif
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+
+// Per function totals (cpu_timenow units)
+struct func_profile_func
+{
+    void               *func;
+    uint32_t            calls;
+    uint64_t            inclusive;
+    uint64_t            exclusive;
+};
+
+// Per call graph edge totals (caller = NULL for a thread's outermost call)
+struct func_profile_edge
+{
+    void               *caller;
+    void               *callee;
+    uint32_t            calls;
+    uint64_t            inclusive;
+};
+
+//-----------------------------------------------------------------
+// Hooks
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+    #define FUNC_PROFILE_SWITCH(from, to)   func_profile_switch(from, to)
+#else
+    #define FUNC_PROFILE_SWITCH(from, to)   do { } while (0)
+#endif
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+
+// Clear all measurements (shadow call stacks are left intact)
+void    func_profile_reset(void);
+
+// Get totals for a function / edge by index (returns 0 if unused)
+int     func_profile_get_func(int idx, struct func_profile_func *func);
+int     func_profile_get_edge(int idx, struct func_profile_edge *edge);
+
+// Dump functions and call graph edges as CSV (see tools/funcprof.py)
+void    func_profile_dump(int (*os_printf)(const char* ctrl1, ... ));
+
+// Thread switch hook (called from thread_load_context)
+void    func_profile_switch(struct thread *from, struct thread *to);
+
+// Compiler instrumentation hooks
+void    __cyg_profile_func_enter(void *this_fn, void *call_site) __attribute__((__no_instrument_function__));
+void    __cyg_profile_func_exit(void *this_fn, void *call_site) __attribute__((__no_instrument_function__));
+
+#endif
+
+#endif
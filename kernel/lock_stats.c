@@ -0,0 +1,294 @@
+#include "lock_stats.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef CONFIG_RTOS_LOCK_STATS
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct lock_stats *  _lock_stats_list = NULL;
+
+//-----------------------------------------------------------------
+// lock_stats_now: Timestamp (0 is reserved for 'not waiting')
+//-----------------------------------------------------------------
+static uint64_t lock_stats_now(void)
+{
+    uint64_t t = cpu_timenow();
+
+    return t ? t : 1;
+}
+//-----------------------------------------------------------------
+// lock_stats_elapsed: Time since 'start' clamped to 32-bits
+//-----------------------------------------------------------------
+static uint32_t lock_stats_elapsed(uint64_t start)
+{
+    int64_t delta = cpu_timediff(cpu_timenow(), start);
+
+    if (delta < 0)
+        return 0;
+    else if (delta > 0xFFFFFFFF)
+        return 0xFFFFFFFF;
+
+    return (uint32_t)delta;
+}
+//-----------------------------------------------------------------
+// lock_stats_register: Add object to the head of the registry on
+// first use. Objects declared using static initialisers (zeroed) are
+// picked up here.
+//-----------------------------------------------------------------
+static void lock_stats_register(struct lock_stats *s, void *object, int type)
+{
+    if (s->registered)
+        return;
+
+    s->object = object;
+    s->type = type;
+    s->registered = 1;
+
+    s->next = _lock_stats_list;
+    _lock_stats_list = s;
+}
+//-----------------------------------------------------------------
+// lock_stats_find: Is this block linked into the registry?
+//-----------------------------------------------------------------
+static int lock_stats_find(struct lock_stats *s)
+{
+    struct lock_stats *item;
+
+    for (item = _lock_stats_list; item; item = item->next)
+        if (item == s)
+            return 1;
+
+    return 0;
+}
+//-----------------------------------------------------------------
+// lock_stats_init: Initialise statistics block and add object to the
+// registry (object memory may be uninitialised or re-initialised).
+// The registry is searched rather than trusting any field of 'object'
+// so that uninitialised memory is never mistaken for an entry.
+//-----------------------------------------------------------------
+void lock_stats_init(struct lock_stats *s, void *object, int type)
+{
+    int cr;
+
+    OS_ASSERT(s != NULL);
+
+    cr = critical_start();
+
+    s->name = NULL;
+    s->acquisitions = 0;
+    s->contended = 0;
+    s->wait_total = 0;
+    s->wait_max = 0;
+    s->depth = 0;
+    s->depth_max = 0;
+    s->hold_start = 0;
+    s->hold_max = 0;
+
+    s->registered = lock_stats_find(s);
+    lock_stats_register(s, object, type);
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// lock_stats_remove: Remove object from the registry
+//-----------------------------------------------------------------
+void lock_stats_remove(struct lock_stats *s)
+{
+    struct lock_stats **link;
+    int cr;
+
+    OS_ASSERT(s != NULL);
+
+    cr = critical_start();
+
+    for (link = &_lock_stats_list; *link; link = &(*link)->next)
+    {
+        if (*link == s)
+        {
+            *link = s->next;
+            break;
+        }
+    }
+
+    s->next = NULL;
+    s->registered = 0;
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// lock_stats_set_name: Name an instrumented object
+//-----------------------------------------------------------------
+void lock_stats_set_name(struct lock_stats *s, const char *name)
+{
+    OS_ASSERT(s != NULL);
+
+    s->name = name;
+}
+//-----------------------------------------------------------------
+// lock_stats_reset: Clear the counters of an instrumented object
+//-----------------------------------------------------------------
+void lock_stats_reset(struct lock_stats *s)
+{
+    int cr;
+
+    OS_ASSERT(s != NULL);
+
+    cr = critical_start();
+
+    s->acquisitions = 0;
+    s->contended = 0;
+    s->wait_total = 0;
+    s->wait_max = 0;
+    s->depth_max = s->depth;
+    s->hold_max = 0;
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// lock_stats_first: Registry of all instrumented objects
+//-----------------------------------------------------------------
+struct lock_stats * lock_stats_first(void)
+{
+    return _lock_stats_list;
+}
+//-----------------------------------------------------------------
+// lock_stats_pend: Thread about to be added to the pending list
+//-----------------------------------------------------------------
+void lock_stats_pend(struct lock_stats *s, void *object, int type, uint64_t *wait_start)
+{
+    lock_stats_register(s, object, type);
+
+    if (++s->depth > s->depth_max)
+        s->depth_max = s->depth;
+
+    *wait_start = lock_stats_now();
+}
+//-----------------------------------------------------------------
+// lock_stats_unpend: Thread removed from the pending list
+//-----------------------------------------------------------------
+void lock_stats_unpend(struct lock_stats *s)
+{
+    if (s->depth > 0)
+        s->depth--;
+}
+//-----------------------------------------------------------------
+// lock_stats_wait: Record time spent on the pending list
+//-----------------------------------------------------------------
+static void lock_stats_wait(struct lock_stats *s, uint64_t wait_start)
+{
+    uint32_t wait = lock_stats_elapsed(wait_start);
+
+    s->contended++;
+    s->wait_total += wait;
+    if (wait > s->wait_max)
+        s->wait_max = wait;
+}
+//-----------------------------------------------------------------
+// lock_stats_acquire: Object acquired (wait_start = 0 if no wait)
+//-----------------------------------------------------------------
+void lock_stats_acquire(struct lock_stats *s, void *object, int type, uint64_t wait_start)
+{
+    lock_stats_register(s, object, type);
+
+    s->acquisitions++;
+
+    if (wait_start)
+        lock_stats_wait(s, wait_start);
+}
+//-----------------------------------------------------------------
+// lock_stats_timeout: Gave up waiting for object
+//-----------------------------------------------------------------
+void lock_stats_timeout(struct lock_stats *s, uint64_t wait_start)
+{
+    if (wait_start)
+        lock_stats_wait(s, wait_start);
+}
+//-----------------------------------------------------------------
+// lock_stats_hold: Start of mutex ownership
+//-----------------------------------------------------------------
+void lock_stats_hold(struct lock_stats *s)
+{
+    s->hold_start = lock_stats_now();
+}
+//-----------------------------------------------------------------
+// lock_stats_release: End of mutex ownership
+//-----------------------------------------------------------------
+void lock_stats_release(struct lock_stats *s)
+{
+    uint32_t hold;
+
+    if (!s->hold_start)
+        return;
+
+    hold = lock_stats_elapsed(s->hold_start);
+    if (hold > s->hold_max)
+        s->hold_max = hold;
+
+    s->hold_start = 0;
+}
+//-----------------------------------------------------------------
+// lock_stats_report: Print the top N objects by total wait time
+//-----------------------------------------------------------------
+void lock_stats_report(int (*os_printf)(const char* ctrl1, ... ), int top_n)
+{
+    struct lock_stats *top[LOCK_STATS_TOP_MAX];
+    struct lock_stats *s;
+    int count = 0;
+    int i;
+    int cr;
+
+    if (top_n > LOCK_STATS_TOP_MAX)
+        top_n = LOCK_STATS_TOP_MAX;
+
+    // Objects may be removed at any time so the registry is walked
+    // with interrupts disabled
+    cr = critical_start();
+
+    // Insertion sort into the top N by total wait time
+    for (s = _lock_stats_list; s ; s = s->next)
+    {
+        if (!s->contended)
+            continue;
+
+        for (i=count;i>0;i--)
+        {
+            if (top[i-1]->wait_total >= s->wait_total)
+                break;
+
+            if (i < top_n)
+                top[i] = top[i-1];
+        }
+
+        if (i < top_n)
+        {
+            top[i] = s;
+            if (count < top_n)
+                count++;
+        }
+    }
+
+    critical_end(cr);
+
+    os_printf("Lock Contention:\r\n");
+    os_printf("Num     Name        Type    Acquired    Contended    Wait Avg    Wait Max    Depth    Hold Max\r\n");
+
+    for (i=0;i<count;i++)
+    {
+        s = top[i];
+
+        os_printf("%d:\t", i+1);
+        if (s->name)
+            os_printf("|%10.10s|\t", s->name);
+        else
+            os_printf("|%10p|\t", s->object);
+        os_printf("%s\t", s->type == LOCK_STATS_MUTEX ? "MTX" : "SEM");
+        os_printf("%ld\t", s->acquisitions);
+        os_printf("%ld\t", s->contended);
+        os_printf("%ld\t", (uint32_t)(s->wait_total / s->contended));
+        os_printf("%ld\t", s->wait_max);
+        os_printf("%ld\t", s->depth_max);
+        os_printf("%ld\r\n", s->hold_max);
+    }
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef __LOCK_STATS_H__
+#define __LOCK_STATS_H__
+
+#include "thread.h"
+
+// To enable lock contention statistics define CONFIG_RTOS_LOCK_STATS.
+// When not defined, no fields are added to mutex / semaphore objects
+// and all hooks compile away.
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+#define LOCK_STATS_MUTEX        0
+#define LOCK_STATS_SEMAPHORE    1
+
+// Max number of entries in a contention report
+#ifndef LOCK_STATS_TOP_MAX
+    #define LOCK_STATS_TOP_MAX  16
+#endif
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct lock_stats
+{
+    // Next item in the registry of instrumented objects
+    struct lock_stats  *next;
+
+    // Owning object (for reporting)
+    void               *object;
+    const char         *name;
+    int                 type;
+
+    // Non-zero once in the registry
+    uint32_t            registered;
+
+    // Number of successful acquisitions (and how many had to wait)
+    uint32_t            acquisitions;
+    uint32_t            contended;
+
+    // Time spent waiting (cpu_timenow units)
+    uint64_t            wait_total;
+    uint32_t            wait_max;
+
+    // Pending list depth (current and worst case)
+    uint32_t            depth;
+    uint32_t            depth_max;
+
+    // Hold time (mutexes only)
+    uint64_t            hold_start;
+    uint32_t            hold_max;
+};
+
+//-----------------------------------------------------------------
+// Hooks
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_LOCK_STATS
+    #define LOCK_STATS_TIME(t)                  uint64_t t = 0
+    #define LOCK_STATS_PEND(s, o, ty, t)        lock_stats_pend(s, o, ty, &(t))
+    #define LOCK_STATS_UNPEND(s)                lock_stats_unpend(s)
+    #define LOCK_STATS_ACQUIRE(s, o, ty, t)     lock_stats_acquire(s, o, ty, t)
+    #define LOCK_STATS_TIMEOUT(s, t)            lock_stats_timeout(s, t)
+    #define LOCK_STATS_HOLD(s)                  lock_stats_hold(s)
+    #define LOCK_STATS_RELEASE(s)               lock_stats_release(s)
+#else
+    #define LOCK_STATS_TIME(t)
+    #define LOCK_STATS_PEND(s, o, ty, t)        do { } while (0)
+    #define LOCK_STATS_UNPEND(s)                do { } while (0)
+    #define LOCK_STATS_ACQUIRE(s, o, ty, t)     do { } while (0)
+    #define LOCK_STATS_TIMEOUT(s, t)            do { } while (0)
+    #define LOCK_STATS_HOLD(s)                  do { } while (0)
+    #define LOCK_STATS_RELEASE(s)               do { } while (0)
+#endif
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_LOCK_STATS
+
+// Initialise statistics block and add object to the registry
+void                lock_stats_init(struct lock_stats *s, void *object, int type);
+
+// Remove object from the registry. Objects which are not static (on the
+// stack or heap) must be removed before their memory is released, and
+// not whilst lock_stats_report is printing them.
+void                lock_stats_remove(struct lock_stats *s);
+
+// Name an instrumented object (string must remain valid)
+void                lock_stats_set_name(struct lock_stats *s, const char *name);
+
+// Clear the counters of an instrumented object
+void                lock_stats_reset(struct lock_stats *s);
+
+// Registry of all instrumented objects (walk using ->next)
+struct lock_stats * lock_stats_first(void);
+
+// Print the top N objects by total wait time
+void                lock_stats_report(int (*os_printf)(const char* ctrl1, ... ), int top_n);
+
+// Kernel hooks (called within critical section)
+void                lock_stats_pend(struct lock_stats *s, void *object, int type, uint64_t *wait_start);
+void                lock_stats_unpend(struct lock_stats *s);
+void                lock_stats_acquire(struct lock_stats *s, void *object, int type, uint64_t wait_start);
+void                lock_stats_timeout(struct lock_stats *s, uint64_t wait_start);
+void                lock_stats_hold(struct lock_stats *s);
+void                lock_stats_release(struct lock_stats *s);
+
+#endif
+
+#endif
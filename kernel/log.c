@@ -0,0 +1,160 @@
+#include "log.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef INCLUDE_LOG
+
+#if (LOG_ENTRIES & (LOG_ENTRIES - 1)) != 0
+    #error "LOG_ENTRIES must be a power of 2"
+#endif
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct log_record    _log_ring[LOG_ENTRIES];
+
+// Producers advance head, the (single) consumer advances tail
+static volatile uint32_t    _log_head;
+static volatile uint32_t    _log_tail;
+static volatile uint32_t    _log_overflows;
+
+static int                  (*_log_printf)(const char* ctrl1, ... );
+static struct thread        _log_thread;
+static stk_t                _log_thread_stack[LOG_THREAD_STACK];
+
+//-----------------------------------------------------------------
+// log_thread_func: Drain thread
+//-----------------------------------------------------------------
+static void *log_thread_func(void *arg)
+{
+    while (1)
+    {
+        // Format everything pending, then sleep until the next poll
+        while (log_drain(_log_printf, LOG_ENTRIES))
+            ;
+
+        thread_sleep(LOG_DRAIN_PERIOD);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// log_init: Initialise logger
+//-----------------------------------------------------------------
+void log_init(int (*os_printf)(const char* ctrl1, ... ), int prio)
+{
+    int i;
+
+    _log_head = 0;
+    _log_tail = 0;
+    _log_overflows = 0;
+    _log_printf = os_printf;
+
+    for (i=0;i<LOG_ENTRIES;i++)
+        _log_ring[i].fmt = NULL;
+
+    if (os_printf)
+        thread_init(&_log_thread, "LOG", prio, log_thread_func, NULL, _log_thread_stack, LOG_THREAD_STACK);
+}
+//-----------------------------------------------------------------
+// log_write: Record a log entry (thread or interrupt context).
+// Never blocks; if the ring is full the record is dropped and counted.
+// Interrupts are masked only whilst the slot is reserved.
+//-----------------------------------------------------------------
+void log_write(const char *fmt, long a0, long a1, long a2, long a3)
+{
+    volatile struct log_record *rec;
+    uint32_t idx;
+    int cr;
+
+    OS_ASSERT(fmt != NULL);
+
+    // Reserve a slot (only the index update is in the critical section)
+    cr = critical_start();
+
+    idx = _log_head;
+    if ((idx - _log_tail) >= LOG_ENTRIES)
+    {
+        _log_overflows++;
+        critical_end(cr);
+        return;
+    }
+    _log_head = idx + 1;
+
+    critical_end(cr);
+
+    // Fill in the record outside of the critical section
+    // (volatile accesses keep the fields ordered before 'fmt')
+    rec = &_log_ring[idx & (LOG_ENTRIES - 1)];
+    rec->timestamp = cpu_timenow();
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+
+    // Publishing the format string marks the record as complete
+    rec->fmt = fmt;
+}
+//-----------------------------------------------------------------
+// log_read: Read the oldest raw record.
+// NOTE: Single consumer only (log_read / log_drain)
+// Returns: 1 if a record was read, 0 if none (or not yet complete)
+//-----------------------------------------------------------------
+int log_read(struct log_record *rec)
+{
+    volatile struct log_record *slot;
+    uint32_t idx = _log_tail;
+    int i;
+
+    if (idx == _log_head)
+        return 0;
+
+    slot = &_log_ring[idx & (LOG_ENTRIES - 1)];
+
+    // Slot reserved but writer not yet finished (preempted)
+    if (slot->fmt == NULL)
+        return 0;
+
+    if (rec)
+    {
+        rec->fmt = slot->fmt;
+        rec->timestamp = slot->timestamp;
+        for (i=0;i<LOG_MAX_ARGS;i++)
+            rec->args[i] = slot->args[i];
+    }
+
+    // Release slot back to the producers
+    slot->fmt = NULL;
+    _log_tail = idx + 1;
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// log_drain: Format up to 'max' pending records
+// NOTE: Single consumer only (log_read / log_drain)
+//-----------------------------------------------------------------
+int log_drain(int (*os_printf)(const char* ctrl1, ... ), int max)
+{
+    struct log_record rec;
+    int count = 0;
+
+    OS_ASSERT(os_printf != NULL);
+
+    while (count < max && log_read(&rec))
+    {
+        // 64-bit timestamp as two 32-bit halves (long may be 32-bit)
+        os_printf("[%08lx%08lx] ", (unsigned long)(uint32_t)(rec.timestamp >> 32), (unsigned long)(uint32_t)rec.timestamp);
+        os_printf(rec.fmt, rec.args[0], rec.args[1], rec.args[2], rec.args[3]);
+        count++;
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------
+// log_overflows: Number of records dropped due to a full ring
+//-----------------------------------------------------------------
+uint32_t log_overflows(void)
+{
+    return _log_overflows;
+}
+#endif
@@ -0,0 +1,80 @@
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include "thread.h"
+
+// Deferred formatting logger.
+// Callers only record the format string pointer, a timestamp and the
+// raw arguments; formatting happens later in log_drain (e.g. from a
+// low priority drain thread) or off-target by reading raw records
+// with log_read and resolving 'fmt' against the ELF image.
+// Safe to call from threads and interrupt handlers: reserving a slot
+// masks interrupts (critical_start) around the ring index update only,
+// the record is then filled with interrupts enabled and published by
+// writing 'fmt'. Timestamps are printed as 64-bit hex.
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+
+// Number of records in the ring (must be a power of 2)
+#ifndef LOG_ENTRIES
+    #define LOG_ENTRIES         64
+#endif
+
+// Max arguments per record
+#define LOG_MAX_ARGS            4
+
+// Drain thread stack size and poll period (ticks)
+#ifndef LOG_THREAD_STACK
+    #define LOG_THREAD_STACK    1024
+#endif
+
+#ifndef LOG_DRAIN_PERIOD
+    #define LOG_DRAIN_PERIOD    10
+#endif
+
+//-----------------------------------------------------------------
+// Macros
+//-----------------------------------------------------------------
+#define LOG0(f)                 log_write(f, 0, 0, 0, 0)
+#define LOG1(f, a)              log_write(f, (long)(a), 0, 0, 0)
+#define LOG2(f, a, b)           log_write(f, (long)(a), (long)(b), 0, 0)
+#define LOG3(f, a, b, c)        log_write(f, (long)(a), (long)(b), (long)(c), 0)
+#define LOG4(f, a, b, c, d)     log_write(f, (long)(a), (long)(b), (long)(c), (long)(d))
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct log_record
+{
+    // Format string (NULL whilst the record is being written)
+    const char * volatile   fmt;
+
+    // cpu_timenow() when recorded
+    uint64_t                timestamp;
+
+    long                    args[LOG_MAX_ARGS];
+};
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+
+// Initialise logger, optionally starting a drain thread at 'prio'
+// (pass os_printf = NULL to drain manually / off-target)
+void        log_init(int (*os_printf)(const char* ctrl1, ... ), int prio);
+
+// Record a log entry (thread or interrupt context)
+void        log_write(const char *fmt, long a0, long a1, long a2, long a3);
+
+// Read the oldest raw record (returns 1 if one was available)
+int         log_read(struct log_record *rec);
+
+// Format up to 'max' pending records (returns number formatted)
+int         log_drain(int (*os_printf)(const char* ctrl1, ... ), int max);
+
+// Number of records dropped due to a full ring
+uint32_t    log_overflows(void);
+
+#endif
@@ -1,6 +1,7 @@
 #include "mailbox.h"
 #include "critical.h"
 #include "os_assert.h"
+#include "api_stats.h"
 
 #ifdef INCLUDE_MAILBOX
 //-----------------------------------------------------------------
@@ -32,10 +33,11 @@ int mailbox_post(struct mailbox *pMbox, uint32_t val)
 {
     int cr;
     int res = 0;
+    API_STATS_BEGIN();
 
     OS_ASSERT(pMbox != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Mailbox has free space?
     if (pMbox->count < pMbox->size)
@@ -59,8 +61,9 @@ int mailbox_post(struct mailbox *pMbox, uint32_t val)
     else
         res = 0;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_MAILBOX_POST);
     return res;
 }
 //-----------------------------------------------------------------
@@ -69,10 +72,11 @@ int mailbox_post(struct mailbox *pMbox, uint32_t val)
 void mailbox_pend(struct mailbox *pMbox, uint32_t *val)
 {
     int cr;
+    API_STATS_BEGIN();
 
     OS_ASSERT(pMbox != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Pend on a new item being added
     semaphore_pend(&pMbox->sema);
@@ -90,7 +94,9 @@ void mailbox_pend(struct mailbox *pMbox, uint32_t *val)
     // Decrement items in queue
     pMbox->count--;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_MAILBOX_PEND);
 }
 //-----------------------------------------------------------------
 // mailbox_pend_timed: Wait for mailbox message (with timeout)
@@ -100,10 +106,11 @@ int mailbox_pend_timed(struct mailbox *pMbox, uint32_t *val, int timeoutMs)
 {
     int cr;
     int result = 0;
+    API_STATS_BEGIN();
 
     OS_ASSERT(pMbox != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Wait for specified timeout period
     if (semaphore_timed_pend(&pMbox->sema, timeoutMs))
@@ -124,8 +131,9 @@ int mailbox_pend_timed(struct mailbox *pMbox, uint32_t *val, int timeoutMs)
         result = 1;
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_MAILBOX_PEND_TIMED);
     return result;
 }
 #endif
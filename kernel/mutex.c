@@ -2,6 +2,7 @@
 #include "thread.h"
 #include "critical.h"
 #include "os_assert.h"
+#include "api_stats.h"
 
 #ifdef INCLUDE_MUTEX
 //-----------------------------------------------------------------
@@ -22,6 +23,10 @@ void mutex_init(struct mutex *mtx, int recursive)
 
     // Pending thread list
     list_init(&mtx->pend_list);
+
+#ifdef CONFIG_RTOS_LOCK_STATS
+    lock_stats_init(&mtx->stats, mtx, LOCK_STATS_MUTEX);
+#endif
 }
 //-----------------------------------------------------------------
 // mutex_lock: Acquire mutex (optionally recursive)
@@ -30,10 +35,12 @@ void mutex_lock(struct mutex *mtx)
 {
     struct thread* this_thread;
     int cr;
+    LOCK_STATS_TIME(wait_start);
+    API_STATS_BEGIN();
 
     OS_ASSERT(mtx != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Get current (this) thread
     this_thread = thread_current();
@@ -45,6 +52,9 @@ void mutex_lock(struct mutex *mtx)
         mtx->owner = this_thread;
 
         OS_ASSERT(mtx->depth == 0);
+
+        LOCK_STATS_ACQUIRE(&mtx->stats, mtx, LOCK_STATS_MUTEX, 0);
+        LOCK_STATS_HOLD(&mtx->stats);
     }
     // Is the mutex already locked by this thread
     else if (mtx->recursive && mtx->owner == this_thread)
@@ -64,12 +74,18 @@ void mutex_lock(struct mutex *mtx)
 
         // Add node to end of pending list
         list_insert_last(&mtx->pend_list, listnode);
+        LOCK_STATS_PEND(&mtx->stats, mtx, LOCK_STATS_MUTEX, wait_start);
 
         // Block the thread from running
         thread_block(this_thread);
+
+        // Ownership has been transferred to us by mutex_unlock
+        LOCK_STATS_ACQUIRE(&mtx->stats, mtx, LOCK_STATS_MUTEX, wait_start);
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_MUTEX_LOCK);
 }
 //-----------------------------------------------------------------
 // mutex_trylock: Acquire mutex, return 1 if acquired, 0 if not
@@ -79,10 +95,11 @@ int mutex_trylock(struct mutex *mtx)
     struct thread* this_thread;
     int cr;
     int result = 0;
+    API_STATS_BEGIN();
 
     OS_ASSERT(mtx != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Get current (this) thread
     this_thread = thread_current();
@@ -95,6 +112,9 @@ int mutex_trylock(struct mutex *mtx)
 
         OS_ASSERT(mtx->depth == 0);
         result = 1;
+
+        LOCK_STATS_ACQUIRE(&mtx->stats, mtx, LOCK_STATS_MUTEX, 0);
+        LOCK_STATS_HOLD(&mtx->stats);
     }
     // Is the mutex already locked by this thread
     else if (mtx->recursive && mtx->owner == this_thread)
@@ -107,8 +127,9 @@ int mutex_trylock(struct mutex *mtx)
     else
         result = 0;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_MUTEX_TRYLOCK);
     return result;
 }
 //-----------------------------------------------------------------
@@ -118,10 +139,11 @@ void mutex_unlock(struct mutex *mtx)
 {
     struct thread* this_thread;
     int cr;
+    API_STATS_BEGIN();
 
     OS_ASSERT(mtx != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Get current (this) thread
     this_thread = thread_current();
@@ -135,6 +157,8 @@ void mutex_unlock(struct mutex *mtx)
     // If there are threads pending on this mutex
     else if (!list_is_empty(&mtx->pend_list))
     {
+        LOCK_STATS_RELEASE(&mtx->stats);
+
         // Unblock the first pending thread
         struct link_node *node = list_first(&mtx->pend_list);
 
@@ -143,17 +167,24 @@ void mutex_unlock(struct mutex *mtx)
 
         // Remove node from linked list
         list_remove(&mtx->pend_list, node);
+        LOCK_STATS_UNPEND(&mtx->stats);
 
         // Transfer mutex ownership
         mtx->owner = thread;
+        LOCK_STATS_HOLD(&mtx->stats);
 
         // Unblock the first waiting thread
         thread_unblock(thread);
     }
     // Else no-one wants it, no owner
     else
+    {
+        LOCK_STATS_RELEASE(&mtx->stats);
         mtx->owner = NULL;
+    }
+
+    KERNEL_UNLOCK(cr);
 
-    critical_end(cr);
+    API_STATS_END(API_STATS_MUTEX_UNLOCK);
 }
 #endif
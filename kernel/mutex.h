@@ -2,6 +2,7 @@
 #define __MUTEX_H__
 
 #include "list.h"
+#include "lock_stats.h"
 
 //-----------------------------------------------------------------
 // Defines
@@ -20,6 +21,10 @@ struct mutex
     int                 recursive;
     int                 depth;
     struct link_list    pend_list;
+
+#ifdef CONFIG_RTOS_LOCK_STATS
+    struct lock_stats   stats;
+#endif
 };
 
 //-----------------------------------------------------------------
@@ -0,0 +1,320 @@
+#include "os_timer.h"
+#include "critical.h"
+#include "os_assert.h"
+
+#ifdef INCLUDE_OS_TIMER
+
+#if (OS_TIMER_WHEEL_SLOTS & (OS_TIMER_WHEEL_SLOTS - 1)) != 0
+    #error "OS_TIMER_WHEEL_SLOTS must be a power of 2"
+#endif
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+// Timer state
+#define OS_TIMER_STOPPED        0
+#define OS_TIMER_RUNNING        1   // In the wheel slot for its expiry
+#define OS_TIMER_EXPIRING       2   // On the expired list (within the tick)
+
+#define OS_TIMER_SLOT(t)        (&_wheel[(t)->expires & (OS_TIMER_WHEEL_SLOTS - 1)])
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct link_list     _wheel[OS_TIMER_WHEEL_SLOTS];
+
+// Timers which expired this tick, being reloaded / dispatched
+static struct link_list     _expired;
+
+// Callbacks waiting for the service thread
+static struct link_list     _pending;
+
+// Service thread blocked waiting for work
+static volatile int         _timer_waiting;
+
+static int                  _timer_initd;
+static struct thread        _timer_thread;
+static stk_t                _timer_thread_stack[OS_TIMER_THREAD_STACK];
+
+//-----------------------------------------------------------------
+// os_timer_insert: Add timer to the wheel, expiring one period from now
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static void os_timer_insert(struct os_timer *timer)
+{
+    timer->expires = thread_tick_count() + timer->period;
+    timer->state = OS_TIMER_RUNNING;
+    list_insert_last(OS_TIMER_SLOT(timer), &timer->node);
+}
+//-----------------------------------------------------------------
+// os_timer_remove: Take timer out of the wheel (or expired list)
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static void os_timer_remove(struct os_timer *timer)
+{
+    if (timer->state == OS_TIMER_RUNNING)
+        list_remove(OS_TIMER_SLOT(timer), &timer->node);
+    else if (timer->state == OS_TIMER_EXPIRING)
+        list_remove(&_expired, &timer->node);
+
+    timer->state = OS_TIMER_STOPPED;
+}
+//-----------------------------------------------------------------
+// os_timer_call: Run a timer callback, recording latency from expiry
+//-----------------------------------------------------------------
+static void os_timer_call(struct os_timer *timer)
+{
+    int64_t latency = cpu_timediff(cpu_timenow(), timer->expired_at);
+
+    if (latency < 0)
+        latency = 0;
+
+    timer->stats.fired++;
+    timer->stats.latency_total += (uint64_t)latency;
+    if ((uint64_t)latency > timer->stats.latency_max)
+        timer->stats.latency_max = (uint32_t)latency;
+
+    timer->func(timer->arg);
+}
+//-----------------------------------------------------------------
+// os_timer_thread_func: Run queued callbacks, then wait for more
+//-----------------------------------------------------------------
+static void *os_timer_thread_func(void *arg)
+{
+    struct link_node *node;
+    struct os_timer *timer;
+    int cr;
+
+    while (1)
+    {
+        cr = critical_start();
+
+        node = list_first(&_pending);
+        if (node)
+        {
+            timer = list_entry(node, struct os_timer, pend_node);
+            list_remove(&_pending, node);
+            timer->pending = 0;
+        }
+        // Nothing queued, wait for a timer to expire
+        else
+        {
+            _timer_waiting = 1;
+            thread_block(&_timer_thread);
+        }
+
+        critical_end(cr);
+
+        // Callback runs with interrupts enabled
+        if (node)
+            os_timer_call(timer);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// os_timer_init: Initialise timer wheel and start the service thread
+// (once only, later calls are ignored as timers may be running)
+//-----------------------------------------------------------------
+void os_timer_init(void)
+{
+    int i;
+
+    if (_timer_initd)
+        return;
+
+    for (i=0;i<OS_TIMER_WHEEL_SLOTS;i++)
+        list_init(&_wheel[i]);
+    list_init(&_expired);
+    list_init(&_pending);
+
+    // Start waiting for work
+    _timer_waiting = 1;
+    thread_init_ex(&_timer_thread, "TIMER", OS_TIMER_THREAD_PRIO, os_timer_thread_func, NULL, _timer_thread_stack, OS_TIMER_THREAD_STACK, THREAD_BLOCKED);
+
+    _timer_initd = 1;
+}
+//-----------------------------------------------------------------
+// os_timer_create: Setup a (stopped) timer
+//-----------------------------------------------------------------
+void os_timer_create(struct os_timer *timer, void (*func)(void *arg), void *arg, uint32_t period, int flags)
+{
+    OS_ASSERT(timer != NULL);
+    OS_ASSERT(func != NULL);
+    OS_ASSERT(period > 0);
+
+    timer->func = func;
+    timer->arg = arg;
+    timer->period = period;
+    timer->expires = 0;
+    timer->flags = flags;
+    timer->state = OS_TIMER_STOPPED;
+    timer->pending = 0;
+    timer->expired_at = 0;
+
+    timer->stats.fired = 0;
+    timer->stats.overruns = 0;
+    timer->stats.latency_max = 0;
+    timer->stats.latency_total = 0;
+}
+//-----------------------------------------------------------------
+// os_timer_start: Start timer (no change if already running)
+//-----------------------------------------------------------------
+void os_timer_start(struct os_timer *timer)
+{
+    int cr;
+
+    OS_ASSERT(timer != NULL);
+    OS_ASSERT(_timer_initd);
+
+    cr = critical_start();
+
+    if (timer->state == OS_TIMER_STOPPED)
+        os_timer_insert(timer);
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// os_timer_reset: Restart timer to expire one period from now
+//-----------------------------------------------------------------
+void os_timer_reset(struct os_timer *timer)
+{
+    int cr;
+
+    OS_ASSERT(timer != NULL);
+    OS_ASSERT(_timer_initd);
+
+    cr = critical_start();
+
+    os_timer_remove(timer);
+    os_timer_insert(timer);
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// os_timer_stop: Stop timer, dropping any callback not yet run
+//-----------------------------------------------------------------
+void os_timer_stop(struct os_timer *timer)
+{
+    int cr;
+
+    OS_ASSERT(timer != NULL);
+
+    cr = critical_start();
+
+    os_timer_remove(timer);
+
+    if (timer->pending)
+    {
+        list_remove(&_pending, &timer->pend_node);
+        timer->pending = 0;
+    }
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// os_timer_set_period: Change period (used from the next start,
+// reset or reload)
+//-----------------------------------------------------------------
+void os_timer_set_period(struct os_timer *timer, uint32_t period)
+{
+    int cr;
+
+    OS_ASSERT(timer != NULL);
+    OS_ASSERT(period > 0);
+
+    cr = critical_start();
+    timer->period = period;
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// os_timer_active: Returns 1 if the timer is running
+//-----------------------------------------------------------------
+int os_timer_active(struct os_timer *timer)
+{
+    OS_ASSERT(timer != NULL);
+
+    return timer->state != OS_TIMER_STOPPED;
+}
+//-----------------------------------------------------------------
+// os_timer_get_stats: Get timer statistics
+//-----------------------------------------------------------------
+void os_timer_get_stats(struct os_timer *timer, struct os_timer_stats *stats)
+{
+    int cr;
+
+    OS_ASSERT(timer != NULL);
+    OS_ASSERT(stats != NULL);
+
+    cr = critical_start();
+    *stats = timer->stats;
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// os_timer_tick: Expire timers due on this tick (only the wheel slot
+// for the current tick is examined)
+// NOTE: Called from the kernel tick (interrupt context)
+//-----------------------------------------------------------------
+void os_timer_tick(void)
+{
+    struct link_list *slot;
+    struct link_node *node;
+    struct link_node *next;
+    struct os_timer *timer;
+    uint32_t now;
+
+    if (!_timer_initd)
+        return;
+
+    now = thread_tick_count();
+    slot = &_wheel[now & (OS_TIMER_WHEEL_SLOTS - 1)];
+
+    // Move everything due now out of the slot (later laps stay)
+    for (node = list_first(slot); node; node = next)
+    {
+        next = list_next(slot, node);
+        timer = list_entry(node, struct os_timer, node);
+
+        if (timer->expires == now)
+        {
+            list_remove(slot, node);
+            list_insert_last(&_expired, node);
+            timer->state = OS_TIMER_EXPIRING;
+            timer->expired_at = cpu_timenow();
+        }
+    }
+
+    // Reload / dispatch one at a time, callbacks may start or stop timers
+    while ((node = list_first(&_expired)) != NULL)
+    {
+        timer = list_entry(node, struct os_timer, node);
+        list_remove(&_expired, node);
+        timer->state = OS_TIMER_STOPPED;
+
+        // Next expiry is relative to this one (no drift)
+        if (timer->flags & OS_TIMER_AUTO_RELOAD)
+        {
+            timer->expires = now + timer->period;
+            timer->state = OS_TIMER_RUNNING;
+            list_insert_last(OS_TIMER_SLOT(timer), &timer->node);
+        }
+
+        if (timer->flags & OS_TIMER_TICK_CONTEXT)
+            os_timer_call(timer);
+        // Previous callback still waiting for the service thread
+        else if (timer->pending)
+            timer->stats.overruns++;
+        else
+        {
+            timer->pending = 1;
+            list_insert_last(&_pending, &timer->pend_node);
+
+            if (_timer_waiting)
+            {
+                _timer_waiting = 0;
+                thread_unblock_irq(&_timer_thread);
+            }
+        }
+    }
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef __OS_TIMER_H__
+#define __OS_TIMER_H__
+
+#include "thread.h"
+#include "list.h"
+
+// Software timers (one-shot and auto-reload) on the kernel tick.
+// Timers hash into a wheel by expiry tick so start / stop / reset are
+// O(1) and may be called from interrupt context. Callbacks run either
+// in the tick interrupt (OS_TIMER_TICK_CONTEXT, must be short and not
+// block) or in the timer service thread (must not block).
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+
+// Number of timer wheel slots (must be a power of 2)
+#ifndef OS_TIMER_WHEEL_SLOTS
+    #define OS_TIMER_WHEEL_SLOTS    64
+#endif
+
+// Timer service thread stack size and priority
+#ifndef OS_TIMER_THREAD_STACK
+    #define OS_TIMER_THREAD_STACK   1024
+#endif
+
+#ifndef OS_TIMER_THREAD_PRIO
+    #define OS_TIMER_THREAD_PRIO    THREAD_MAX_PRIO
+#endif
+
+// Timer flags
+#define OS_TIMER_ONE_SHOT           0
+#define OS_TIMER_AUTO_RELOAD        (1 << 0)    // Restart every period
+#define OS_TIMER_TICK_CONTEXT       (1 << 1)    // Callback in the tick interrupt
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct os_timer_stats
+{
+    // Callbacks run
+    uint32_t            fired;
+
+    // Expiries while the previous callback was still waiting to run
+    uint32_t            overruns;
+
+    // Expiry to start of callback latency (cpu_timenow units)
+    uint32_t            latency_max;
+    uint64_t            latency_total;
+};
+
+struct os_timer
+{
+    // Wheel slot and service thread queue membership
+    struct link_node    node;
+    struct link_node    pend_node;
+
+    void                (*func)(void *arg);
+    void                *arg;
+
+    // Period and absolute expiry (ticks)
+    uint32_t            period;
+    uint32_t            expires;
+    int                 flags;
+
+    // Stopped, in the wheel or being expired (see os_timer.c)
+    int                 state;
+
+    // Waiting for the service thread to run the callback
+    int                 pending;
+
+    // cpu_timenow() at the last expiry
+    uint64_t            expired_at;
+
+    struct os_timer_stats stats;
+};
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+
+// Initialise timer wheel and start the timer service thread (repeat
+// calls have no effect)
+void        os_timer_init(void);
+
+// Setup a (stopped) timer, period in ticks
+void        os_timer_create(struct os_timer *timer, void (*func)(void *arg), void *arg, uint32_t period, int flags);
+
+// Start timer to expire one period from now (no change if already running)
+void        os_timer_start(struct os_timer *timer);
+
+// Restart timer to expire one period from now
+void        os_timer_reset(struct os_timer *timer);
+
+// Stop timer (and drop a callback waiting for the service thread)
+void        os_timer_stop(struct os_timer *timer);
+
+// Change the period used from the next (re)start or reload
+void        os_timer_set_period(struct os_timer *timer, uint32_t period);
+
+// Returns 1 if the timer is running
+int         os_timer_active(struct os_timer *timer);
+
+// Get timer statistics
+void        os_timer_get_stats(struct os_timer *timer, struct os_timer_stats *stats);
+
+// Advance timers, called by the kernel tick
+void        os_timer_tick(void);
+
+#endif
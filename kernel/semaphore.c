@@ -1,6 +1,7 @@
 #include "semaphore.h"
 #include "critical.h"
 #include "os_assert.h"
+#include "api_stats.h"
 
 #ifdef INCLUDE_SEMAPHORE
 //-----------------------------------------------------------------
@@ -15,6 +16,10 @@ void semaphore_init(struct semaphore *pSem, uint32_t initial_count)
 
     // Pending thread list
     list_init(&pSem->pend_list);
+
+#ifdef CONFIG_RTOS_LOCK_STATS
+    lock_stats_init(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE);
+#endif
 }
 //-----------------------------------------------------------------
 // semaphore_pend: Decrement semaphore or block if already 0
@@ -22,14 +27,19 @@ void semaphore_init(struct semaphore *pSem, uint32_t initial_count)
 void semaphore_pend(struct semaphore *pSem)
 {
     int cr;
+    LOCK_STATS_TIME(wait_start);
+    API_STATS_BEGIN();
 
     OS_ASSERT(pSem != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // If one immediatly available
     if (pSem->count > 0)
+    {
         pSem->count--;
+        LOCK_STATS_ACQUIRE(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, 0);
+    }
     // None available, add to queue
     else
     {
@@ -43,12 +53,17 @@ void semaphore_pend(struct semaphore *pSem)
 
         // Add node to end of pending list
         list_insert_last(&pSem->pend_list, listnode);
+        LOCK_STATS_PEND(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, wait_start);
 
         // Block the thread from running
         thread_block(this_thread);
+
+        LOCK_STATS_ACQUIRE(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, wait_start);
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_SEMAPHORE_PEND);
 }
 //-----------------------------------------------------------------
 // semaphore_post: Increment semaphore count
@@ -59,7 +74,7 @@ static void semaphore_post_internal(struct semaphore *pSem, int irq)
 
     OS_ASSERT(pSem != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // Increment semaphore count
     pSem->count++;
@@ -75,6 +90,7 @@ static void semaphore_post_internal(struct semaphore *pSem, int irq)
 
         // Remove node from linked list
         list_remove(&pSem->pend_list, node);
+        LOCK_STATS_UNPEND(&pSem->stats);
 
         // Count down semaphore which has been taken by the
         // pending thread...
@@ -90,21 +106,44 @@ static void semaphore_post_internal(struct semaphore *pSem, int irq)
             thread_unblock(thread);
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 }
+#ifdef CONFIG_RTOS_ISR_DEFER
+//-----------------------------------------------------------------
+// semaphore_post_deferred: Queued semaphore_post_irq request
+//-----------------------------------------------------------------
+static void semaphore_post_deferred(void *arg)
+{
+    semaphore_post_internal((struct semaphore *)arg, 1);
+}
+#endif
 //-----------------------------------------------------------------
 // semaphore_post: Increment semaphore count
 //-----------------------------------------------------------------
 void semaphore_post(struct semaphore *pSem)
 {
+    API_STATS_BEGIN();
+
     semaphore_post_internal(pSem, 0);
+
+    API_STATS_END(API_STATS_SEMAPHORE_POST);
 }
 //-----------------------------------------------------------------
 // semaphore_post_irq: Increment semaphore (interrupt context safe)
 //-----------------------------------------------------------------
 void semaphore_post_irq(struct semaphore *pSem)
 {
+    API_STATS_BEGIN();
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+    // Count and pend list are updated by the kernel after the IRQ
+    if (thread_isr_defer(semaphore_post_deferred, pSem))
+        cpu_context_switch_irq();
+#else
     semaphore_post_internal(pSem, 1);
+#endif
+
+    API_STATS_END(API_STATS_SEMAPHORE_POST_IRQ);
 }
 //-----------------------------------------------------------------
 // semaphore_try: Attempt to decrement semaphore or return 0
@@ -113,45 +152,54 @@ int semaphore_try(struct semaphore *pSem)
 {
     int result;
     int cr;
+    API_STATS_BEGIN();
 
     OS_ASSERT(pSem != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // If one immediatly available
     if (pSem->count > 0)
     {
         pSem->count--;
         result = 1;
+
+        LOCK_STATS_ACQUIRE(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, 0);
     }
     // None available currently
     else
         result = 0;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_SEMAPHORE_TRY);
     return result;
 }
 //-----------------------------------------------------------------
-// semaphore_timed_pend: Decrement semaphore (with timeout)
+// semaphore_timed_pend_internal: Decrement semaphore (with timeout
+// in ticks which may expire up to slack late, or with a high
+// resolution timeout in cpu_timenow() units)
 //-----------------------------------------------------------------
-int semaphore_timed_pend(struct semaphore *pSem, int timeoutMs)
+static int semaphore_timed_pend_internal(struct semaphore *pSem, uint64_t timeout, uint32_t slack, int hr)
 {
     int cr;
     int result = 0;
+    LOCK_STATS_TIME(wait_start);
 
     OS_ASSERT(pSem != NULL);
 
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     // If one immediatly available
     if (pSem->count > 0)
     {
         pSem->count--;
         result = 1;
+
+        LOCK_STATS_ACQUIRE(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, 0);
     }
     // None available, add to queue (if timeout specified)
-    else if (timeoutMs > 0)
+    else if (timeout > 0)
     {
         struct link_node *listnode;
 
@@ -163,16 +211,25 @@ int semaphore_timed_pend(struct semaphore *pSem, int timeoutMs)
 
         // Add node to end of pending list
         list_insert_last(&pSem->pend_list, listnode);
+        LOCK_STATS_PEND(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, wait_start);
 
         // Clear unblocking arg
         this_thread->unblocking_arg = NULL;
 
         // Send the thread to sleep for the timeout period
-        thread_sleep(timeoutMs);
+#ifdef CONFIG_RTOS_HRTIMER
+        if (hr)
+            thread_sleep_hr(timeout);
+        else
+#endif
+            thread_sleep_slack((uint32_t)timeout, slack);
 
         // Is the thread awake due to a semaphore_post?
         if (this_thread->unblocking_arg != NULL)
+        {
             result = 1;
+            LOCK_STATS_ACQUIRE(&pSem->stats, pSem, LOCK_STATS_SEMAPHORE, wait_start);
+        }
         // Else we must have timed out
         else
         {
@@ -189,6 +246,7 @@ int semaphore_timed_pend(struct semaphore *pSem, int timeoutMs)
                 {
                     // Remove node from linked list
                     list_remove(pList, node);
+                    LOCK_STATS_UNPEND(&pSem->stats);
 
                     // Stop scanning this list!
                     break;
@@ -198,14 +256,61 @@ int semaphore_timed_pend(struct semaphore *pSem, int timeoutMs)
             // We should not have reached the end of the list without finding our entry.
             OS_ASSERT(node != NULL);
 
+            LOCK_STATS_TIMEOUT(&pSem->stats, wait_start);
             result = 0;
         }
     }
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
+
+    return result;
+}
+//-----------------------------------------------------------------
+// semaphore_timed_pend: Decrement semaphore (with timeout)
+//-----------------------------------------------------------------
+int semaphore_timed_pend(struct semaphore *pSem, int timeoutMs)
+{
+    int result;
+    API_STATS_BEGIN();
+
+    result = semaphore_timed_pend_internal(pSem, timeoutMs > 0 ? timeoutMs : 0, 0, 0);
+
+    API_STATS_END(API_STATS_SEMAPHORE_TIMED_PEND);
+    return result;
+}
+//-----------------------------------------------------------------
+// semaphore_timed_pend_slack: Decrement semaphore (with timeout).
+// The timeout may expire up to slackMs late to share the wakeup of
+// another sleeping thread.
+//-----------------------------------------------------------------
+int semaphore_timed_pend_slack(struct semaphore *pSem, int timeoutMs, int slackMs)
+{
+    int result;
+    API_STATS_BEGIN();
+
+    OS_ASSERT(slackMs >= 0);
+
+    result = semaphore_timed_pend_internal(pSem, timeoutMs > 0 ? timeoutMs : 0, slackMs, 0);
 
+    API_STATS_END(API_STATS_SEMAPHORE_TIMED_PEND_SLACK);
     return result;
 }
+#ifdef CONFIG_RTOS_HRTIMER
+//-----------------------------------------------------------------
+// semaphore_timed_pend_hr: Decrement semaphore (with a high resolution
+// timeout in cpu_timenow() units)
+//-----------------------------------------------------------------
+int semaphore_timed_pend_hr(struct semaphore *pSem, uint64_t timeout)
+{
+    int result;
+    API_STATS_BEGIN();
+
+    result = semaphore_timed_pend_internal(pSem, timeout, 0, 1);
+
+    API_STATS_END(API_STATS_SEMAPHORE_TIMED_PEND_HR);
+    return result;
+}
+#endif
 //-----------------------------------------------------------------
 // semaphore_get_value: Value access
 //-----------------------------------------------------------------
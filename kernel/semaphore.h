@@ -3,6 +3,7 @@
 
 #include "thread.h"
 #include "list.h"
+#include "lock_stats.h"
 
 //-----------------------------------------------------------------
 // Defines
@@ -18,6 +19,10 @@ struct semaphore
 {
     uint32_t            count;
     struct link_list    pend_list;
+
+#ifdef CONFIG_RTOS_LOCK_STATS
+    struct lock_stats   stats;
+#endif
 };
 
 //-----------------------------------------------------------------
@@ -30,7 +35,9 @@ void    semaphore_init(struct semaphore *pSem, uint32_t initial_count);
 // Increment semaphore count
 void    semaphore_post(struct semaphore *pSem);
 
-// Increment semaphore (interrupt context safe)
+// Increment semaphore (interrupt context safe).
+// With CONFIG_RTOS_ISR_DEFER the count changes on interrupt exit (or when
+// the interrupted thread releases the kernel lock), not within the ISR.
 void    semaphore_post_irq(struct semaphore *pSem);
 
 // Decrement semaphore or block if already 0
@@ -42,6 +49,14 @@ int     semaphore_try(struct semaphore *pSem);
 // Decrement semaphore (with timeout)
 int     semaphore_timed_pend(struct semaphore *pSem, int timeoutMs);
 
+// Decrement semaphore (with timeout which may expire up to slackMs late)
+int     semaphore_timed_pend_slack(struct semaphore *pSem, int timeoutMs, int slackMs);
+
+#ifdef CONFIG_RTOS_HRTIMER
+// Decrement semaphore (with high resolution timeout, cpu_timenow() units)
+int     semaphore_timed_pend_hr(struct semaphore *pSem, uint64_t timeout);
+#endif
+
 // Get semaphore value
 uint32_t semaphore_get_value(struct semaphore *pSem);
 
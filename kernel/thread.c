@@ -1,6 +1,9 @@
 #include "thread.h"
 #include "critical.h"
 #include "os_assert.h"
+#include "api_stats.h"
+#include "func_profile.h"
+#include "os_timer.h"
 
 //-----------------------------------------------------------------
 // Defines:
@@ -11,6 +14,17 @@
     #define IDLE_TASK_STACK        256
 #endif
 
+#ifndef THREAD_TICK_WAKE_STACK
+    #define THREAD_TICK_WAKE_STACK  IDLE_TASK_STACK
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+// Cyclic executive job state
+#define THREAD_CYCLIC_NONE          0   // Not waiting for a slot
+#define THREAD_CYCLIC_WAITING       1   // Job complete, waiting for next slot
+#define THREAD_CYCLIC_SUSPENDED     2   // Job overran its slot, resumes in next slot
+#endif
+
 //-----------------------------------------------------------------
 // Locals:
 //-----------------------------------------------------------------
@@ -18,26 +32,221 @@ static struct link_list     _thread_runnable;
 static struct link_list     _thread_blocked;
 static struct link_list     _thread_sleeping;
 static struct link_list     _thread_dead;
+#ifdef CONFIG_RTOS_HRTIMER
+// High resolution sleepers, ordered by wake time
+static struct link_list     _thread_hrsleeping;
+#endif
 static struct thread*       _current_thread = NULL;
 static struct thread        _idle_task;
 static struct thread*       _thread_list_all = NULL;
 static volatile uint32_t    _tick_count;
 static volatile uint32_t    _thread_picks;
-static uint32_t             _idle_task_stack[IDLE_TASK_STACK];
+static stk_t                _idle_task_stack[IDLE_TASK_STACK];
 static int                  _thread_id;
 static int                  _initd = 0;
 static int                  _running;
 
+// Current thread to move behind its equal priority peers at the next pick
+// (yield or end of round-robin time slice)
+static int                  _thread_rotate;
+
+// Reschedule deferred while the current thread held the scheduler lock
+static int                  _sched_pending;
+
+// Sleeps which joined the wakeup of another thread (timer slack)
+static uint32_t             _sleep_coalesced;
+
+#ifdef CONFIG_RTOS_EDF
+// Run-able EDF threads, binary min-heap ordered by deadline
+static struct thread*       _edf_heap[THREAD_EDF_MAX];
+static int                  _edf_ready;
+static int                  _edf_threads;
+static uint32_t             _edf_misses;
+#define THREAD_IS_EDF(t)        ((t)->policy == THREAD_SCHED_EDF)
+#else
+#define THREAD_IS_EDF(t)        0
+#endif
+
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+// Time slicing is disabled while a preemption threshold is set
+#define THREAD_TIME_SLICED(t)   ((t)->policy == THREAD_SCHED_RR && (t)->preempt_threshold <= (t)->priority)
+#else
+#define THREAD_TIME_SLICED(t)   ((t)->policy == THREAD_SCHED_RR)
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+static const struct thread_cyclic_frame* _cyclic_table;
+static int                  _cyclic_frames;
+static int                  _cyclic_frame;
+static int                  _cyclic_slot;
+
+// Per slot statistics (optional) and index of the current slot in them
+static struct thread_cyclic_stats* _cyclic_stats;
+static int                  _cyclic_index;
+static uint32_t             _cyclic_slot_left;
+static int                  _cyclic_done;
+
+// Thread owning the current slot (NULL = none)
+static struct thread*       _cyclic_thread;
+#endif
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+// Expired sleepers beyond THREAD_TICK_WAKE_MAX are woken by this thread
+static struct thread        _tick_wake_thread;
+static stk_t                _tick_wake_stack[THREAD_TICK_WAKE_STACK];
+static int                  _tick_wake_waiting;
+static uint32_t             _tick_wake_spills;
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+// Ticks not yet taken off the head of the sleep list
+static uint32_t             _tick_lag;
+#define THREAD_SLEEP_LEFT(total)    ((total) > _tick_lag ? (total) - _tick_lag : 0)
+#endif
+#endif
+
+#ifndef THREAD_SLEEP_LEFT
+#define THREAD_SLEEP_LEFT(total)    (total)
+#endif
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+#if (THREAD_ISR_QUEUE_ENTRIES & (THREAD_ISR_QUEUE_ENTRIES - 1)) != 0
+    #error "THREAD_ISR_QUEUE_ENTRIES must be a power of 2"
+#endif
+
+struct thread_isr_request
+{
+    void            (*func)(void *arg);
+    void            *arg;
+};
+
+// Interrupts (which do not nest) advance head, the kernel advances
+// tail with interrupts masked
+static struct thread_isr_request _isr_queue[THREAD_ISR_QUEUE_ENTRIES];
+static volatile uint32_t    _isr_head;
+static volatile uint32_t    _isr_tail;
+
+// Requests being applied, ISR APIs called from them act directly
+static int                  _isr_processing;
+
+// Kernel catching up on behalf of interrupts (with them masked), the
+// kernel lock is not taken and requests queued are drained before it ends
+static int                  _kernel_catchup;
+static struct thread_isr_queue_stats _isr_stats;
+
+// Held off while the interrupted thread had the kernel lock
+static volatile uint32_t    _tick_pending;
+static volatile int         _kernel_resched;
+#ifdef CONFIG_RTOS_HRTIMER
+static volatile int         _hrtimer_pending;
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+static struct thread_reservation* _reservations;
+static uint64_t             _res_start;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+static uint32_t             _load_window_ticks;
+static struct thread*       _load_update_next;
+static const int            _load_avg_shift[] = THREAD_LOAD_AVG_SHIFTS;
+
+// THREAD_LOAD_AVG_SHIFTS must have THREAD_LOAD_AVG_COUNT entries
+typedef char                thread_load_avg_check[(sizeof(_load_avg_shift) / sizeof(_load_avg_shift[0]) == THREAD_LOAD_AVG_COUNT) ? 1 : -1];
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+static struct thread_irq_stats _irq_stats[THREAD_IRQ_SOURCES];
+static uint64_t             _irq_start;
+static int                  _irq_source;
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+static uint32_t             _irq_run_time;
+#endif
+#endif
+
 //-----------------------------------------------------------------
 // Prototypes:
 //-----------------------------------------------------------------
 static void *               thread_idle_task(void* arg);
 static struct thread*       thread_pick(void);
+static int                  thread_keep_current(void);
 static void                 thread_func(void *pThd);
 
 static void                 thread_switch(void);
+static void                 thread_tick_int(void);
 static void                 thread_insert_priority(struct link_list *pList, struct thread *pInsertNode);
+static void                 thread_change_priority(struct thread *pThread, int pri);
 static void                 thread_unblock_int(struct thread *pThread);
+static void                 thread_sleep_coalesce(struct thread *pSleepThread, struct thread *pThread);
+
+#ifdef CONFIG_RTOS_HRTIMER
+static void                 thread_hrsleep_insert(struct thread *pThread, uint64_t wake_time);
+static void                 thread_hrsleep_remove(struct thread *pThread);
+static void                 thread_hrtimer_int(void);
+#define THREAD_HR_SLEEPING(t)   ((t)->state == THREAD_SLEEPING && (t)->hr_sleeping)
+#else
+#define THREAD_HR_SLEEPING(t)   0
+#endif
+static void                 thread_ready_add(struct thread *pThread);
+static void                 thread_ready_remove(struct thread *pThread);
+static struct thread*       thread_ready_first(void);
+static int                  thread_preempts(struct thread *pThread, struct thread *pOther);
+static int                  thread_effective_priority(struct thread *pThread);
+
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+static int                  thread_below_threshold(struct thread *pThread);
+#endif
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+static int                  thread_sleep_expire(int max);
+static void                 thread_ready_add_batch(struct link_list *batch);
+static void *               thread_tick_wake_task(void* arg);
+#endif
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+static void                 thread_isr_process(void);
+static void                 thread_unblock_deferred(void *arg);
+static int                  thread_kernel_locked(void);
+static void                 thread_kernel_catchup(void);
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+static void                 thread_cyclic_tick(void);
+static void                 thread_cyclic_release(void);
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+static void                 thread_reservation_charge(uint64_t now);
+static void                 thread_reservation_replenish(void);
+static void                 thread_reservation_update(struct thread_reservation *res);
+#endif
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+static int                  thread_sleep_until_int(uint32_t wake_tick);
+static void                 thread_period_reset(struct thread_period_stats *stats);
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+static void                 thread_edf_insert(struct thread *pThread);
+static void                 thread_edf_remove(struct thread *pThread);
+static void                 thread_edf_update(struct thread *pThread);
+static void                 thread_edf_check_misses(void);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+static void                 thread_wake_record(struct thread *pThread);
+#define THREAD_MARK_READY(t)    do { (t)->ready_time = cpu_timenow(); if (!(t)->ready_time) (t)->ready_time = 1; } while (0)
+#else
+#define THREAD_MARK_READY(t)    do { } while (0)
+#endif
+
+#ifdef CONFIG_RTOS_API_STATS
+static void                 thread_api_switch(struct thread *from, struct thread *to);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+static void                 thread_charge_run_time(struct thread *pThread, uint64_t now);
+static void                 thread_load_update(void);
+#endif
 
 //-----------------------------------------------------------------
 // thread_kernel_init: Initialise the RTOS kernel
@@ -54,16 +263,73 @@ int thread_kernel_init(void)
     list_init(&_thread_sleeping);
     list_init(&_thread_blocked);
     list_init(&_thread_dead);
+#ifdef CONFIG_RTOS_HRTIMER
+    list_init(&_thread_hrsleeping);
+#endif
 
     _thread_list_all = NULL;
     _thread_id = 0;
     _tick_count = 0;
     _thread_picks = 0;
     _running = 0;
+    _thread_rotate = 0;
+    _sched_pending = 0;
+    _sleep_coalesced = 0;
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+    _tick_wake_spills = 0;
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+    _tick_lag = 0;
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+    _edf_ready = 0;
+    _edf_threads = 0;
+    _edf_misses = 0;
+#endif
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+    _isr_head = 0;
+    _isr_tail = 0;
+    _isr_processing = 0;
+    _kernel_catchup = 0;
+    _isr_stats.requests = 0;
+    _isr_stats.overflows = 0;
+    _isr_stats.depth_max = 0;
+    _isr_stats.ticks_deferred = 0;
+    _tick_pending = 0;
+    _kernel_resched = 0;
+#ifdef CONFIG_RTOS_HRTIMER
+    _hrtimer_pending = 0;
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    _reservations = NULL;
+    _res_start = 0;
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    _cyclic_table = NULL;
+    _cyclic_stats = NULL;
+    _cyclic_thread = NULL;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    _load_window_ticks = 0;
+    _load_update_next = NULL;
+#endif
 
     // Create an idle task
     thread_init(&_idle_task, "IDLE_TASK", THREAD_IDLE_PRIO, thread_idle_task, (void*)NULL, (void*)_idle_task_stack, IDLE_TASK_STACK);
 
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+    // Deferred wakeup pass, waits for a tick to spill
+    _tick_wake_waiting = 1;
+    thread_init_ex(&_tick_wake_thread, "TICK_WAKE", THREAD_INT_PRIO, thread_tick_wake_task, NULL, (void*)_tick_wake_stack, THREAD_TICK_WAKE_STACK, THREAD_BLOCKED);
+#endif
+
     _initd = 1;
     return 1;
 }
@@ -90,6 +356,7 @@ int thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)
 {
     int cr;
     int l = 0;
+    API_STATS_BEGIN();
 
     OS_ASSERT(pThread != NULL);
 
@@ -107,6 +374,37 @@ int thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)
 
     // Setup priority
     pThread->priority = pri;
+    pThread->base_priority = pri;
+
+    // Default scheduling policy
+    pThread->policy = THREAD_SCHED_RR;
+    pThread->quantum = THREAD_DEFAULT_QUANTUM;
+    pThread->quantum_left = pThread->quantum;
+
+#ifdef CONFIG_RTOS_EDF
+    // No deadline to miss until one is set
+    pThread->deadline = 0;
+    pThread->edf_index = -1;
+    pThread->deadline_misses = 0;
+    pThread->deadline_missed = 1;
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    pThread->reservation = NULL;
+#endif
+
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+    pThread->preempt_threshold = THREAD_IDLE_PRIO;
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    pThread->cyclic_state = THREAD_CYCLIC_NONE;
+#endif
+
+#ifdef CONFIG_RTOS_HRTIMER
+    pThread->hr_sleeping = 0;
+    pThread->hr_wakeup = 0;
+#endif
 
     // Thread function
     pThread->thread_func = f;
@@ -114,17 +412,50 @@ int thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)
 
     pThread->state = initial_state;
     pThread->run_count = 0;
+    pThread->sched_lock = 0;
+#ifdef CONFIG_RTOS_ISR_DEFER
+    pThread->kernel_lock = 0;
+#endif
     pThread->exit_value = NULL;
 
 #ifdef CONFIG_RTOS_ABSOLUTE_TIME
     pThread->wakeup_time = 0;
 #else
     pThread->wait_delta = 0;
+    pThread->period = 0;
+    pThread->next_release = 0;
+    thread_period_reset(&pThread->period_stats);
 #endif
 
 #ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
     pThread->run_time = 0;
     pThread->run_start = 0;
+    pThread->run_time_total = 0;
+    pThread->run_time_window = 0;
+    pThread->load_time = 0;
+    for (l=0;l<THREAD_LOAD_AVG_COUNT;l++)
+        pThread->load_avg[l] = 0;
+#endif
+
+#ifdef CONFIG_RTOS_API_STATS
+    pThread->api_switched = 0;
+    pThread->api_switch_out = 0;
+#endif
+
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+    pThread->prof_depth = 0;
+    pThread->prof_switched = 0;
+    pThread->prof_switch_out = 0;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    pThread->ready_time = 0;
+    pThread->wake_max = 0;
+    for (l=0;l<THREAD_WAKE_HIST_BUCKETS;l++)
+        pThread->wake_hist[l] = 0;
+
+    if (initial_state == THREAD_RUNABLE)
+        THREAD_MARK_READY(pThread);
 #endif
 
     // Join list init
@@ -134,13 +465,13 @@ int thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)
     cpu_thread_init_tcb(&pThread->tcb, thread_func, pThread, stack, stack_size);
 
     // Begin critical section
-    cr = critical_start();
+    cr = KERNEL_LOCK();
 
     pThread->thread_id = ++_thread_id;
 
     // Runable: Insert this thread at the end of run list
     if (initial_state == THREAD_RUNABLE)
-        thread_insert_priority(&_thread_runnable, pThread);
+        thread_ready_add(pThread);
     else if (initial_state == THREAD_BLOCKED)
         list_insert_last(&_thread_blocked, &pThread->node);
     else
@@ -155,8 +486,9 @@ int thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)
     // Set the checkword
     pThread->checkword = THREAD_CHECK_WORD;
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
+    API_STATS_END(API_STATS_THREAD_INIT);
     return 1;
 }
 //-----------------------------------------------------------------
@@ -167,162 +499,547 @@ int thread_init(struct thread *pThread, const char *name, int pri, void *(*f)(vo
     return thread_init_ex(pThread, name, pri, f, arg, stack, stack_size, THREAD_RUNABLE);
 }
 //-----------------------------------------------------------------
-// thread_kill: Kill thread and remove from all thread lists.
-// Once complete, thread data/stack will not be accessed again by
-// RTOS.
-// You cannot kill a thread from itself, use thread_suicide instead.
-// Returns: 1 = ok, 0 = failed
+// thread_set_priority: Change thread priority (thread context only).
+// A run-able thread moves to the end of its new priority level, and if
+// a different thread should now be running it is switched to at once.
+// Threads pending on objects stay in the same (FIFO) pend list position.
+// Returns: 1 on success, 0 on invalid priority
 //-----------------------------------------------------------------
-int thread_kill(struct thread *pThread)
+int thread_set_priority(struct thread *pThread, int pri)
 {
-    int ok = 0;
-    struct thread *pCurr = NULL;
-    struct thread *pLast = NULL;
-    int cr = critical_start();
+    int cr;
+    API_STATS_BEGIN();
 
-    // Thread cannot kill itself using thread_kill
-    if (pThread != _current_thread)
-    {
-        // Thread currently runable: remove from run list
-        if (pThread->state == THREAD_RUNABLE)
-            list_remove(&_thread_runnable, &pThread->node);
-        // Blocked: remove from blocked list
-        else if (pThread->state == THREAD_BLOCKED)
-            list_remove(&_thread_blocked, &pThread->node);
-        // Sleeping: remove from sleep list
-        else if (pThread->state == THREAD_SLEEPING)
-        {
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-            // Is there another thread after this in the delta timer list?
-            struct link_node *node = list_next(&_thread_sleeping, &pThread->node);
-            if (node)
-            {
-                struct thread *pNextThread = list_entry(node, struct thread, node);
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
 
-                // Add current item's remaining time to next
-                pNextThread->wait_delta += pThread->wait_delta;
-            }
-#endif
-            // Remove from sleeping list
-            list_remove(&_thread_sleeping, &pThread->node);
-        }
-        // Dead: Remove from dead list
-        else if (pThread->state == THREAD_DEAD)
-            list_remove(&_thread_dead, &pThread->node);
-        else
-            OS_PANIC("Unknown thread state!");
+    // Idle task must stay the lowest priority thread
+    if (pThread == &_idle_task || pri <= THREAD_IDLE_PRIO)
+    {
+        API_STATS_END(API_STATS_THREAD_SET_PRIORITY);
+        return 0;
+    }
 
-        // Remove from simple 'all threads' list
-        pCurr = _thread_list_all;
-        while (pCurr != NULL)
-        {
-            if (pCurr == pThread)
-            {
-                if (pLast != NULL)
-                    pLast->next_all = pCurr->next_all;
-                else
-                    _thread_list_all = pCurr->next_all;
-                break;
-            }
-            else
-                pCurr = pCurr->next_all;
+    cr = KERNEL_LOCK();
 
-            pLast = pCurr;
-        }
+    // EDF threads run at THREAD_EDF_PRIO until returned to a fixed
+    // priority policy, and threads with an exhausted CPU reservation
+    // stay demoted until it is replenished
+    pThread->base_priority = pri;
+    thread_change_priority(pThread, thread_effective_priority(pThread));
 
-        ok = 1;
-    }
+    // Is another thread now the best candidate to run?
+    if (_running && _current_thread && thread_ready_first() != _current_thread)
+        thread_switch();
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
-    return ok;
+    API_STATS_END(API_STATS_THREAD_SET_PRIORITY);
+    return 1;
 }
 //-----------------------------------------------------------------
-// thread_suicide: Allows a thread to self terminate.
+// thread_set_policy: Set scheduling policy & round-robin time slice
+// in ticks (0 = THREAD_DEFAULT_QUANTUM, ignored for FIFO).
+// THREAD_SCHED_EDF threads run at THREAD_EDF_PRIO, ordered by deadline
+// (see thread_set_deadline), and return to their set priority when
+// moved back to a fixed priority policy.
+// Returns: 1 on success, 0 on invalid policy (or too many EDF threads)
 //-----------------------------------------------------------------
-void thread_suicide(struct thread *pThread, void *exit_arg)
+int thread_set_policy(struct thread *pThread, tThreadPolicy policy, uint32_t quantum)
 {
-    int cr = critical_start();
+    int cr;
 
-    OS_ASSERT(pThread == _current_thread);
-    OS_ASSERT(pThread->state == THREAD_RUNABLE);
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
 
-    // Remove from the run list
-    list_remove(&_thread_runnable, &pThread->node);
-    
-    // Mark thread as dead and add to dead thread list
-    pThread->state = THREAD_DEAD;
-    list_insert_last(&_thread_dead, &pThread->node);
+#ifdef CONFIG_RTOS_EDF
+    if (policy != THREAD_SCHED_RR && policy != THREAD_SCHED_FIFO && policy != THREAD_SCHED_EDF)
+        return 0;
 
-    // Record optional exit arg for later use
-    pThread->exit_value = exit_arg;
+    // The idle task must stay the lowest priority thread
+    if (policy == THREAD_SCHED_EDF && pThread == &_idle_task)
+        return 0;
+#else
+    if (policy != THREAD_SCHED_RR && policy != THREAD_SCHED_FIFO)
+        return 0;
+#endif
 
-    // If there are threads pending on this thread exiting
-    while (!list_is_empty(&pThread->join_list))
+    if (quantum == 0)
+        quantum = THREAD_DEFAULT_QUANTUM;
+
+    cr = KERNEL_LOCK();
+
+#ifdef CONFIG_RTOS_EDF
+    // Moving into or out of the EDF class
+    if ((policy == THREAD_SCHED_EDF) != THREAD_IS_EDF(pThread))
     {
-        // Unblock the first pending thread
-        struct link_node *node = list_first(&pThread->join_list);
+        if (policy == THREAD_SCHED_EDF && _edf_threads >= THREAD_EDF_MAX)
+        {
+            KERNEL_UNLOCK(cr);
+            return 0;
+        }
 
-        // Get the thread item
-        struct thread* thread = list_entry(node, struct thread, blocking_node);
+        if (pThread->state == THREAD_RUNABLE)
+            thread_ready_remove(pThread);
 
-        // Remove node from linked list
-        list_remove(&pThread->join_list, node);
+        _edf_threads += (policy == THREAD_SCHED_EDF) ? 1 : -1;
 
-        // Unblock the waiting thread
-        thread_unblock_int(thread);
+        pThread->policy = policy;
+        pThread->priority = thread_effective_priority(pThread);
+
+        if (pThread->state == THREAD_RUNABLE)
+            thread_ready_add(pThread);
     }
+#endif
 
-    // Switch context to the new highest priority thread
-    cpu_context_switch();
+    pThread->policy = policy;
+    pThread->quantum = quantum;
 
-    critical_end(cr);
+    // Start a fresh time slice
+    pThread->quantum_left = quantum;
+
+#ifdef CONFIG_RTOS_EDF
+    // Is another thread now the best candidate to run?
+    if (_running && _current_thread && thread_ready_first() != _current_thread)
+        thread_switch();
+#endif
+
+    KERNEL_UNLOCK(cr);
+
+    return 1;
 }
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
 //-----------------------------------------------------------------
-// thread_join: Wait for thread to exit
+// thread_set_preempt_threshold: While running, the thread can only be
+// preempted by threads with a priority above the threshold, so a group
+// of threads with priorities up to the threshold do not preempt each
+// other. A threshold at or below the thread's priority disables this.
+// Returns: 1 on success, 0 on invalid threshold
 //-----------------------------------------------------------------
-void* thread_join(struct thread *pThread)
+int thread_set_preempt_threshold(struct thread *pThread, int threshold)
 {
-    void *res;
     int cr;
 
-    OS_ASSERT(pThread);
-
-    // Can't wait for ourselves to exit!
-    OS_ASSERT(pThread != _current_thread);
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
 
-    cr = critical_start();
+    if (threshold > THREAD_MAX_PRIO)
+        return 0;
 
-    // If thread alive
-    if (pThread->state != THREAD_DEAD)
-    {
-        // Setup list node
-        struct link_node * listnode = &_current_thread->blocking_node;
+    cr = KERNEL_LOCK();
 
-        // Add node to end of pending join list
-        list_insert_last(&pThread->join_list, listnode);
+    pThread->preempt_threshold = threshold;
 
-        // Block the thread from running
-        thread_block(_current_thread);
-    }
-    
-    res = pThread->exit_value;
+    // Lowered threshold: a waiting thread may now preempt
+    if (_running && pThread == _current_thread && thread_ready_first() != _current_thread)
+        thread_switch();
 
-    critical_end(cr);
+    KERNEL_UNLOCK(cr);
 
-    return res;
+    return 1;
 }
+#endif
+#ifdef CONFIG_RTOS_CPU_RESERVATION
 //-----------------------------------------------------------------
-// thread_sleep_thread: Put a specific thread on to the sleep queue
+// thread_reservation_init: Init CPU budget reservation. Threads attached
+// to it may run for 'budget' (cpu_timenow units) every 'period' ticks at
+// their own priority, then run at demote_prio until replenished.
+// NOTE: The reservation must remain valid for the lifetime of the kernel
 //-----------------------------------------------------------------
-void thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units)
+void thread_reservation_init(struct thread_reservation *res, uint64_t budget, uint32_t period, int demote_prio)
 {
-    int cr = critical_start();
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-    uint32_t total = 0;
-    uint32_t prevtotal = 0;
-#endif
-    struct link_node *node;
+    int cr;
+
+    OS_ASSERT(res != NULL);
+    OS_ASSERT(period != 0);
+    OS_ASSERT(demote_prio > THREAD_IDLE_PRIO);
+
+    res->budget = budget;
+    res->period = period;
+    res->demote_prio = demote_prio;
+    res->remaining = budget;
+    res->exhausted = 0;
+    res->exhaustions = 0;
+
+    cr = KERNEL_LOCK();
+
+    res->next_replenish = _tick_count + period;
+
+    res->next = _reservations;
+    _reservations = res;
+
+    KERNEL_UNLOCK(cr);
+}
+//-----------------------------------------------------------------
+// thread_reservation_attach: Charge thread's CPU time to a reservation
+// (NULL = unlimited). Several threads may share one reservation.
+// Switches at once if another thread should now be running.
+// NOTE: EDF threads are not demoted
+//-----------------------------------------------------------------
+void thread_reservation_attach(struct thread *pThread, struct thread_reservation *res)
+{
+    int cr;
+
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    OS_ASSERT(pThread != &_idle_task);
+
+    cr = KERNEL_LOCK();
+
+    pThread->reservation = res;
+    thread_change_priority(pThread, thread_effective_priority(pThread));
+
+    // Is another thread now the best candidate to run?
+    if (_running && _current_thread && thread_ready_first() != _current_thread)
+        thread_switch();
+
+    KERNEL_UNLOCK(cr);
+}
+#endif
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+//-----------------------------------------------------------------
+// thread_cyclic_init: Start time-triggered dispatch from a static table
+// of minor frames (one major frame). Each slot's thread is released at
+// the start of the slot and runs exclusively, bypassing the priority
+// scheduler, until it calls thread_cyclic_wait or the slot ends (an
+// overrun: the job is suspended and resumes in the thread's next slot).
+// Other threads are priority scheduled in empty / completed slots.
+// Table threads must be run-able (not yet started) when this is called
+// and should not block on other objects. Release / overrun counts go in
+// 'stats' if provided (one entry per slot, in table order).
+//-----------------------------------------------------------------
+void thread_cyclic_init(const struct thread_cyclic_frame *table, int num_frames, struct thread_cyclic_stats *stats)
+{
+    struct thread *pThread;
+    int cr;
+    int f;
+    int s;
+    int idx = 0;
+
+    OS_ASSERT(table != NULL);
+    OS_ASSERT(num_frames > 0);
+
+    cr = KERNEL_LOCK();
+
+    // Table threads only run in their own slots
+    for (f=0;f<num_frames;f++)
+    {
+        OS_ASSERT(table[f].num_slots > 0);
+
+        for (s=0;s<table[f].num_slots;s++)
+        {
+            OS_ASSERT(table[f].slots[s].ticks > 0);
+
+            if (stats)
+            {
+                stats[idx].releases = 0;
+                stats[idx].overruns = 0;
+            }
+            idx++;
+
+            pThread = table[f].slots[s].thread;
+            if (pThread && pThread->state == THREAD_RUNABLE)
+            {
+                OS_ASSERT(pThread != _current_thread);
+
+                thread_ready_remove(pThread);
+                pThread->state = THREAD_BLOCKED;
+                pThread->cyclic_state = THREAD_CYCLIC_WAITING;
+                list_insert_last(&_thread_blocked, &pThread->node);
+            }
+        }
+    }
+
+    _cyclic_table = table;
+    _cyclic_frames = num_frames;
+    _cyclic_frame = 0;
+    _cyclic_slot = 0;
+    _cyclic_stats = stats;
+    _cyclic_index = 0;
+
+    // Release the first slot
+    thread_cyclic_release();
+
+    if (_running && _cyclic_thread && _cyclic_thread->state == THREAD_RUNABLE)
+        thread_switch();
+
+    KERNEL_UNLOCK(cr);
+}
+//-----------------------------------------------------------------
+// thread_cyclic_wait: Complete the current job and wait for the
+// thread's next slot
+//-----------------------------------------------------------------
+void thread_cyclic_wait(void)
+{
+    int cr = KERNEL_LOCK();
+
+    if (_current_thread == _cyclic_thread)
+        _cyclic_done = 1;
+
+    _current_thread->cyclic_state = THREAD_CYCLIC_WAITING;
+    thread_block(_current_thread);
+
+    KERNEL_UNLOCK(cr);
+}
+//-----------------------------------------------------------------
+// thread_cyclic_dump: Dump per slot release / overrun counts
+//-----------------------------------------------------------------
+void thread_cyclic_dump(int (*os_printf)(const char* ctrl1, ... ))
+{
+    const struct thread_cyclic_slot *slot;
+    int idx = 0;
+    int f;
+    int s;
+
+    if (!_cyclic_table)
+        return;
+
+    os_printf("Cyclic Executive:\r\n");
+    os_printf("Frame\tSlot\tThread        Ticks\tRelease\tOverrun\r\n");
+
+    for (f=0;f<_cyclic_frames;f++)
+        for (s=0;s<_cyclic_table[f].num_slots;s++,idx++)
+        {
+            slot = &_cyclic_table[f].slots[s];
+            os_printf("%d\t%d\t", f, s);
+            os_printf("%-14s", slot->thread ? slot->thread->name : "-");
+            os_printf("%ld\t", slot->ticks);
+            if (_cyclic_stats)
+                os_printf("%ld\t%ld\r\n", _cyclic_stats[idx].releases, _cyclic_stats[idx].overruns);
+            else
+                os_printf("-\t-\r\n");
+        }
+}
+#endif
+#ifdef CONFIG_RTOS_EDF
+//-----------------------------------------------------------------
+// thread_set_deadline: Set the absolute deadline (tick count) of an
+// EDF thread, e.g. release time + relative deadline at the start of
+// each job (thread context only). Switches at once if another thread
+// should now be running.
+//-----------------------------------------------------------------
+void thread_set_deadline(struct thread *pThread, uint32_t deadline)
+{
+    int cr;
+
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+
+    cr = KERNEL_LOCK();
+
+    pThread->deadline = deadline;
+    pThread->deadline_missed = 0;
+
+    // Re-order within the ready heap
+    if (pThread->edf_index >= 0)
+        thread_edf_update(pThread);
+
+    // Is another thread now the best candidate to run?
+    if (_running && _current_thread && thread_ready_first() != _current_thread)
+        thread_switch();
+
+    KERNEL_UNLOCK(cr);
+}
+//-----------------------------------------------------------------
+// thread_edf_misses: Total number of EDF deadlines missed
+//-----------------------------------------------------------------
+uint32_t thread_edf_misses(void)
+{
+    return _edf_misses;
+}
+#endif
+//-----------------------------------------------------------------
+// thread_kill: Kill thread and remove from all thread lists.
+// Once complete, thread data/stack will not be accessed again by
+// RTOS.
+// You cannot kill a thread from itself, use thread_suicide instead.
+// Returns: 1 = ok, 0 = failed
+//-----------------------------------------------------------------
+int thread_kill(struct thread *pThread)
+{
+    int ok = 0;
+    struct thread *pCurr = NULL;
+    struct thread *pLast = NULL;
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    // Thread cannot kill itself using thread_kill
+    if (pThread != _current_thread)
+    {
+        // Thread currently runable: remove from run list
+        if (pThread->state == THREAD_RUNABLE)
+            thread_ready_remove(pThread);
+        // Blocked: remove from blocked list
+        else if (pThread->state == THREAD_BLOCKED)
+            list_remove(&_thread_blocked, &pThread->node);
+#ifdef CONFIG_RTOS_HRTIMER
+        // High resolution sleep: remove from that list
+        else if (THREAD_HR_SLEEPING(pThread))
+            thread_hrsleep_remove(pThread);
+#endif
+        // Sleeping: remove from sleep list
+        else if (pThread->state == THREAD_SLEEPING)
+        {
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+            // Is there another thread after this in the delta timer list?
+            struct link_node *node = list_next(&_thread_sleeping, &pThread->node);
+            if (node)
+            {
+                struct thread *pNextThread = list_entry(node, struct thread, node);
+
+                // Add current item's remaining time to next
+                pNextThread->wait_delta += pThread->wait_delta;
+            }
+#endif
+            // Remove from sleeping list
+            list_remove(&_thread_sleeping, &pThread->node);
+        }
+        // Dead: Remove from dead list
+        else if (pThread->state == THREAD_DEAD)
+            list_remove(&_thread_dead, &pThread->node);
+        else
+            OS_PANIC("Unknown thread state!");
+
+#ifdef CONFIG_RTOS_EDF
+        if (THREAD_IS_EDF(pThread))
+            _edf_threads--;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+        // Load average update part way through the list, skip this one
+        if (_load_update_next == pThread)
+            _load_update_next = pThread->next_all;
+#endif
+
+        // Remove from simple 'all threads' list
+        pCurr = _thread_list_all;
+        while (pCurr != NULL)
+        {
+            if (pCurr == pThread)
+            {
+                if (pLast != NULL)
+                    pLast->next_all = pCurr->next_all;
+                else
+                    _thread_list_all = pCurr->next_all;
+                break;
+            }
+            else
+                pCurr = pCurr->next_all;
+
+            pLast = pCurr;
+        }
+
+        ok = 1;
+    }
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_KILL);
+    return ok;
+}
+//-----------------------------------------------------------------
+// thread_suicide: Allows a thread to self terminate.
+//-----------------------------------------------------------------
+void thread_suicide(struct thread *pThread, void *exit_arg)
+{
+    int cr = critical_start();
+
+    OS_ASSERT(pThread == _current_thread);
+    OS_ASSERT(pThread->state == THREAD_RUNABLE);
+
+    // Remove from the run list
+    thread_ready_remove(pThread);
+
+#ifdef CONFIG_RTOS_EDF
+    if (THREAD_IS_EDF(pThread))
+        _edf_threads--;
+#endif
+
+    // Mark thread as dead and add to dead thread list
+    pThread->state = THREAD_DEAD;
+    list_insert_last(&_thread_dead, &pThread->node);
+
+    // Record optional exit arg for later use
+    pThread->exit_value = exit_arg;
+
+    // If there are threads pending on this thread exiting
+    while (!list_is_empty(&pThread->join_list))
+    {
+        // Unblock the first pending thread
+        struct link_node *node = list_first(&pThread->join_list);
+
+        // Get the thread item
+        struct thread* thread = list_entry(node, struct thread, blocking_node);
+
+        // Remove node from linked list
+        list_remove(&pThread->join_list, node);
+
+        // Unblock the waiting thread
+        thread_unblock_int(thread);
+    }
+
+    // Switch context to the new highest priority thread
+    cpu_context_switch();
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// thread_join: Wait for thread to exit
+//-----------------------------------------------------------------
+void* thread_join(struct thread *pThread)
+{
+    void *res;
+    int cr;
+    API_STATS_BEGIN();
+
+    OS_ASSERT(pThread);
+
+    // Can't wait for ourselves to exit!
+    OS_ASSERT(pThread != _current_thread);
+
+    cr = KERNEL_LOCK();
+
+    // If thread alive
+    if (pThread->state != THREAD_DEAD)
+    {
+        // Setup list node
+        struct link_node * listnode = &_current_thread->blocking_node;
+
+        // Add node to end of pending join list
+        list_insert_last(&pThread->join_list, listnode);
+
+        // Block the thread from running
+        thread_block(_current_thread);
+    }
+    
+    res = pThread->exit_value;
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_JOIN);
+    return res;
+}
+//-----------------------------------------------------------------
+// thread_sleep_thread: Put a specific thread on to the sleep queue
+//-----------------------------------------------------------------
+void thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units)
+{
+    thread_sleep_thread_slack(pSleepThread, time_units, 0);
+}
+//-----------------------------------------------------------------
+// thread_sleep_thread_slack: Put a specific thread on to the sleep
+// queue. If another thread wakes within 'slack' units after the
+// requested time, wake with it instead of on a tick of its own.
+//-----------------------------------------------------------------
+void thread_sleep_thread_slack(struct thread *pSleepThread, uint32_t time_units, uint32_t slack)
+{
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+    uint32_t total = 0;
+    uint32_t prevtotal = 0;
+#endif
+    struct link_node *node;
 
     OS_ASSERT(pSleepThread);
 
@@ -330,7 +1047,7 @@ void thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units)
     if (pSleepThread->state == THREAD_RUNABLE)
     {
         // Remove from the run list
-        list_remove(&_thread_runnable, &pSleepThread->node);
+        thread_ready_remove(pSleepThread);
     }
     // or is it blocked
     else if (pSleepThread->state == THREAD_BLOCKED)
@@ -350,6 +1067,11 @@ void thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units)
 #else
     // NOTE: Add 1 to the sleep time to get at least the time slept for.
     time_units = time_units + 1;
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+    // Ticks still owed to the head of the list apply to this thread too
+    time_units += _tick_lag;
+#endif
 #endif
 
     // Get the first sleeping thread
@@ -379,63 +1101,1130 @@ void thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units)
             total += pThread->wait_delta;
 #endif
 
-            // New timeout less than total (or end of list reached)
+            // First wakeup at or after the requested time is within the slack
 #ifdef CONFIG_RTOS_ABSOLUTE_TIME
-            if (pSleepThread->wakeup_time <= pThread->wakeup_time)
+            if (slack && pSleepThread->wakeup_time <= pThread->wakeup_time &&
+                pThread->wakeup_time - pSleepThread->wakeup_time <= slack)
 #else
-            if (time_units <= total)
+            if (slack && time_units <= total && total - time_units <= slack)
 #endif
             {
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+                thread_sleep_coalesce(pSleepThread, pThread);
+                break;
+            }
+
+            // New timeout less than total (or end of list reached)
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+            if (pSleepThread->wakeup_time <= pThread->wakeup_time)
+#else
+            if (time_units <= total)
+#endif
+            {
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+                // delta time from previous to this node
+                pSleepThread->wait_delta = time_units - prevtotal;
+#endif
+
+                // Insert into list before this sleeping thread
+                list_insert_before(&_thread_sleeping, &pThread->node, &pSleepThread->node);
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+                // Adjust next nodes delta time
+                pThread->wait_delta -= pSleepThread->wait_delta;
+#endif
+                break;
+            }
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+            prevtotal = total;
+#endif
+
+            // End of list reached, still not added
+            if (list_next(&_thread_sleeping, node) == NULL)
+            {
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
                 // delta time from previous to this node
                 pSleepThread->wait_delta = time_units - prevtotal;
 #endif
 
-                // Insert into list before this sleeping thread
-                list_insert_before(&_thread_sleeping, &pThread->node, &pSleepThread->node);
+                // Insert into list after last node (end of list)
+                list_insert_last(&_thread_sleeping, &pSleepThread->node);
+                break;
+            }
+        }
+    }
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP_THREAD);
+}
+//-----------------------------------------------------------------
+// thread_sleep_cancel: Stop a thread from sleeping
+//-----------------------------------------------------------------
+void thread_sleep_cancel(struct thread *pThread)
+{
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    OS_ASSERT(pThread);
+
+#ifdef CONFIG_RTOS_HRTIMER
+    // High resolution sleep (the one-shot timer may still fire, harmlessly)
+    if (THREAD_HR_SLEEPING(pThread))
+    {
+        thread_hrsleep_remove(pThread);
+        pThread->state = THREAD_BLOCKED;
+        list_insert_last(&_thread_blocked, &pThread->node);
+    }
+    else
+#endif
+    // If the item has not already expired (and is in the sleeping list)
+    if (pThread->state == THREAD_SLEEPING)
+    {
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+        // Is there another thread after this in the delta list?
+        struct link_node *node = list_next(&_thread_sleeping, &pThread->node);
+        if (node)
+        {
+            struct thread *pNextThread = list_entry(node, struct thread, node);
+
+            // Add current item's remaining time to next
+            pNextThread->wait_delta += pThread->wait_delta;
+        }
+
+        // Clear the sleep timer
+        pThread->wait_delta = 0;
+#endif
+
+        // Remove from the sleeping list
+        list_remove(&_thread_sleeping, &pThread->node);
+
+        // Until this thread is put back in the run list or
+        // is re-added to the sleep list then mark as blocked.
+        pThread->state = THREAD_BLOCKED;
+        list_insert_last(&_thread_blocked, &pThread->node);
+    }
+    // Else thread timeout has expired and is now runable (or blocked)
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP_CANCEL);
+}
+//-----------------------------------------------------------------
+// thread_sleep_coalesce: Add sleeping thread to the sleep list to wake
+// on the same tick as pThread (after any others already sharing it)
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_sleep_coalesce(struct thread *pSleepThread, struct thread *pThread)
+{
+    struct link_node *node = &pThread->node;
+    struct link_node *next;
+    struct thread *pNext;
+
+    while ((next = list_next(&_thread_sleeping, node)) != NULL)
+    {
+        pNext = list_entry(next, struct thread, node);
+
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+        if (pNext->wakeup_time != pThread->wakeup_time)
+#else
+        if (pNext->wait_delta != 0)
+#endif
+            break;
+
+        node = next;
+    }
+
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+    pSleepThread->wakeup_time = pThread->wakeup_time;
+#else
+    // Same expiry as the previous node
+    pSleepThread->wait_delta = 0;
+#endif
+
+    list_insert_after(&_thread_sleeping, node, &pSleepThread->node);
+    _sleep_coalesced++;
+}
+//-----------------------------------------------------------------
+// thread_sleep_coalesced: Number of sleeps which shared the wakeup of
+// another thread
+//-----------------------------------------------------------------
+uint32_t thread_sleep_coalesced(void)
+{
+    return _sleep_coalesced;
+}
+//-----------------------------------------------------------------
+// thread_sleep: Sleep thread for x time units
+//-----------------------------------------------------------------
+void thread_sleep(uint32_t time_units)
+{
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    // Put the current thread to sleep
+    if (time_units > 0)
+        thread_sleep_thread(_current_thread, time_units);
+    // Yield: Let equal priority threads run first
+    else
+        _thread_rotate = 1;
+
+    // Switch context to the next highest priority thread
+    thread_switch();
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP);
+}
+#ifdef CONFIG_RTOS_HRTIMER
+//-----------------------------------------------------------------
+// thread_sleep_hr: Sleep thread for a duration in cpu_timenow() units
+//-----------------------------------------------------------------
+void thread_sleep_hr(uint64_t duration)
+{
+    thread_sleep_hr_until(cpu_timenow() + duration);
+}
+//-----------------------------------------------------------------
+// thread_sleep_hr_until: Sleep until cpu_timenow() reaches wake_time
+// Returns: 1 if slept, 0 if wake_time has already passed
+//-----------------------------------------------------------------
+int thread_sleep_hr_until(uint64_t wake_time)
+{
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    if (cpu_timediff(wake_time, cpu_timenow()) <= 0)
+    {
+        KERNEL_UNLOCK(cr);
+        API_STATS_END(API_STATS_THREAD_SLEEP_HR);
+        return 0;
+    }
+
+    thread_hrsleep_insert(_current_thread, wake_time);
+
+    // Switch context to the next highest priority thread
+    thread_switch();
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP_HR);
+    return 1;
+}
+//-----------------------------------------------------------------
+// thread_hrsleep_insert: Move a run-able thread to the high resolution
+// sleep list, re-arming the one-shot timer if it is now first to wake
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_hrsleep_insert(struct thread *pThread, uint64_t wake_time)
+{
+    struct link_node *node;
+    struct thread *pOther;
+
+    OS_ASSERT(pThread->state == THREAD_RUNABLE);
+
+    thread_ready_remove(pThread);
+    pThread->state = THREAD_SLEEPING;
+    pThread->hr_sleeping = 1;
+    pThread->hr_wakeup = wake_time;
+
+    // After any thread waking at the same time
+    list_for_each(&_thread_hrsleeping, node)
+    {
+        pOther = list_entry(node, struct thread, node);
+        if (cpu_timediff(wake_time, pOther->hr_wakeup) < 0)
+            break;
+    }
+
+    if (node)
+        list_insert_before(&_thread_hrsleeping, node, &pThread->node);
+    else
+        list_insert_last(&_thread_hrsleeping, &pThread->node);
+
+    if (list_first(&_thread_hrsleeping) == &pThread->node)
+        cpu_hrtimer_set(wake_time);
+}
+//-----------------------------------------------------------------
+// thread_hrsleep_remove: Remove a thread from the high resolution
+// sleep list. The one-shot timer is left armed, an early expiry
+// finds nothing to wake and re-arms for the next sleeper.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_hrsleep_remove(struct thread *pThread)
+{
+    list_remove(&_thread_hrsleeping, &pThread->node);
+    pThread->hr_sleeping = 0;
+}
+//-----------------------------------------------------------------
+// thread_hrtimer_irq: One-shot timer expiry
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_hrtimer_irq(void)
+{
+#ifdef CONFIG_RTOS_ISR_DEFER
+    _hrtimer_pending = 1;
+
+    // Interrupted a thread updating the kernel lists, wake the sleepers
+    // (and re-arm) when it releases the kernel lock. Meanwhile only the
+    // tick is armed.
+    if (thread_kernel_locked())
+    {
+        cpu_hrtimer_set(0);
+        return;
+    }
+
+    thread_kernel_catchup();
+#else
+    thread_hrtimer_int();
+#endif
+}
+//-----------------------------------------------------------------
+// thread_hrtimer_int: Wake every high resolution sleeper whose time
+// has come and re-arm for the next
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_hrtimer_int(void)
+{
+    struct link_node *node;
+    struct thread *pThread = NULL;
+    uint64_t now = cpu_timenow();
+
+    while ((node = list_first(&_thread_hrsleeping)) != NULL)
+    {
+        pThread = list_entry(node, struct thread, node);
+
+        if (cpu_timediff(pThread->hr_wakeup, now) > 0)
+            break;
+
+        thread_hrsleep_remove(pThread);
+
+        pThread->state = THREAD_RUNABLE;
+        THREAD_MARK_READY(pThread);
+        thread_ready_add(pThread);
+    }
+
+    // Next to wake (0 = disarm)
+    cpu_hrtimer_set(node ? pThread->hr_wakeup : 0);
+}
+#endif
+//-----------------------------------------------------------------
+// thread_sleep_slack: Sleep thread for x time units, allowing the
+// wakeup to be up to 'slack' units late
+//-----------------------------------------------------------------
+void thread_sleep_slack(uint32_t time_units, uint32_t slack)
+{
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    // Put the current thread to sleep
+    if (time_units > 0)
+        thread_sleep_thread_slack(_current_thread, time_units, slack);
+    // Yield: Let equal priority threads run first
+    else
+        _thread_rotate = 1;
+
+    // Switch context to the next highest priority thread
+    thread_switch();
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP_SLACK);
+}
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+//-----------------------------------------------------------------
+// thread_sleep_until_int: Sleep current thread until the tick count
+// reaches wake_tick (absolute, so no drift accumulates).
+// Returns: 1 if slept, 0 if wake_tick has already been reached
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static int thread_sleep_until_int(uint32_t wake_tick)
+{
+    int32_t remain = (int32_t)(wake_tick - _tick_count);
+
+    if (remain <= 0)
+        return 0;
+
+    // thread_sleep_thread rounds a relative sleep up by a tick, which
+    // is not required when sleeping to a tick boundary.
+    thread_sleep_thread(_current_thread, remain - 1);
+    thread_switch();
+    return 1;
+}
+//-----------------------------------------------------------------
+// thread_sleep_until: Sleep until the tick count reaches wake_tick
+// Returns: 1 if slept, 0 if wake_tick has already been reached
+//-----------------------------------------------------------------
+int thread_sleep_until(uint32_t wake_tick)
+{
+    int slept;
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    slept = thread_sleep_until_int(wake_tick);
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_SLEEP_UNTIL);
+    return slept;
+}
+//-----------------------------------------------------------------
+// thread_set_period: Make thread periodic with the first job released
+// at tick first_release (period 0 = not periodic). Resets statistics.
+//-----------------------------------------------------------------
+void thread_set_period(struct thread *pThread, uint32_t period, uint32_t first_release)
+{
+    int cr;
+
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+
+    cr = KERNEL_LOCK();
+
+    pThread->period = period;
+    pThread->next_release = first_release;
+    thread_period_reset(&pThread->period_stats);
+
+    KERNEL_UNLOCK(cr);
+}
+//-----------------------------------------------------------------
+// thread_wait_next_period: Complete the current job of a periodic
+// thread and wait for the next release.
+// Releases are at first_release + n * period, independent of how long
+// each job took. If the job ran past one or more release points they
+// are counted as overruns and skipped; the thread is released at once
+// from the latest passed point so it stays in phase.
+// Returns: number of release points missed (0 = on time)
+//-----------------------------------------------------------------
+uint32_t thread_wait_next_period(void)
+{
+    struct thread *pThread;
+    struct thread_period_stats *stats;
+    uint32_t release;
+    uint32_t missed = 0;
+    uint32_t jitter;
+    int32_t late;
+    API_STATS_BEGIN();
+    int cr = KERNEL_LOCK();
+
+    pThread = _current_thread;
+    stats = &pThread->period_stats;
+    OS_ASSERT(pThread->period != 0);
+
+    release = pThread->next_release;
+    late = (int32_t)(_tick_count - release);
+    if (late > 0)
+    {
+        missed = ((uint32_t)late + pThread->period - 1) / pThread->period;
+        release += ((uint32_t)late / pThread->period) * pThread->period;
+        stats->overruns += missed;
+    }
+
+    pThread->next_release = release + pThread->period;
+
+#ifdef CONFIG_RTOS_EDF
+    // Implicit deadline: the end of the period
+    pThread->deadline = pThread->next_release;
+    pThread->deadline_missed = 0;
+    if (pThread->edf_index >= 0)
+        thread_edf_update(pThread);
+#endif
+
+    // Released already, but may no longer be the best thread to run
+    if (!thread_sleep_until_int(release) && thread_ready_first() != _current_thread)
+        thread_switch();
+
+    // Release jitter (ticks late starting the job)
+    jitter = _tick_count - release;
+    stats->releases++;
+    stats->jitter_last = jitter;
+    stats->jitter_total += jitter;
+    if (jitter > stats->jitter_max)
+        stats->jitter_max = jitter;
+
+    KERNEL_UNLOCK(cr);
+
+    API_STATS_END(API_STATS_THREAD_WAIT_NEXT_PERIOD);
+    return missed;
+}
+//-----------------------------------------------------------------
+// thread_period_reset: Clear periodic release statistics
+//-----------------------------------------------------------------
+static void thread_period_reset(struct thread_period_stats *stats)
+{
+    stats->releases = 0;
+    stats->overruns = 0;
+    stats->jitter_last = 0;
+    stats->jitter_max = 0;
+    stats->jitter_total = 0;
+}
+//-----------------------------------------------------------------
+// thread_get_period_stats: Get periodic release statistics
+//-----------------------------------------------------------------
+void thread_get_period_stats(struct thread *pThread, struct thread_period_stats *stats)
+{
+    int cr;
+
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(stats != NULL);
+
+    cr = critical_start();
+    *stats = pThread->period_stats;
+    critical_end(cr);
+}
+#endif
+//-----------------------------------------------------------------
+// thread_switch: Switch context to the highest priority thread
+//-----------------------------------------------------------------
+static void thread_switch(void)
+{
+    // Get the current run count
+    uint32_t oldRuncount = _current_thread->run_count;
+#ifdef CONFIG_RTOS_ISR_DEFER
+    int cr;
+#endif
+
+    // Scheduler locked and this thread can keep running: defer the
+    // switch until thread_sched_unlock
+    if (_current_thread->sched_lock && _current_thread->state == THREAD_RUNABLE)
+    {
+        _sched_pending = 1;
+        return;
+    }
+
+    // Cause context switch
+#ifdef CONFIG_RTOS_ISR_DEFER
+    // (callers may only hold the kernel lock, the switch itself must not
+    // be interrupted)
+    cr = critical_start();
+    cpu_context_switch();
+    critical_end(cr);
+#else
+    cpu_context_switch();
+#endif
+
+    // In-order to get back to this point, we must have been
+    // picked by thread_pick() and the run-count incremented.
+    OS_ASSERT(oldRuncount != (_current_thread->run_count));
+
+    // This thread must be in the run list otherwise something has gone wrong!
+    OS_ASSERT(_current_thread->state == THREAD_RUNABLE);
+}
+#ifdef CONFIG_RTOS_API_STATS
+//-----------------------------------------------------------------
+// thread_api_switch: Thread switch (voluntary or preemption) - note
+// when the outgoing thread stopped running and add the time the
+// incoming thread was switched out to its api_switched total.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_api_switch(struct thread *from, struct thread *to)
+{
+    uint64_t now = cpu_timenow();
+
+    if (from)
+        from->api_switch_out = now;
+
+    if (to->api_switch_out)
+    {
+        to->api_switched += cpu_timediff(now, to->api_switch_out);
+        to->api_switch_out = 0;
+    }
+}
+#endif
+//-----------------------------------------------------------------
+// thread_load_context: Find highest priority run-able thread to run
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_load_context(int preempt)
+{
+    struct thread * pThread;
+    API_STATS_BEGIN();
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+    // Interrupted a thread updating the kernel lists, reschedule when
+    // it releases the kernel lock
+    if (preempt && thread_kernel_locked())
+    {
+        _kernel_resched = 1;
+        API_STATS_END(API_STATS_THREAD_LOAD_CONTEXT);
+        return;
+    }
+
+    // Apply requests and ticks held off by interrupts before picking
+    thread_kernel_catchup();
+    _kernel_resched = 0;
+#endif
+
+    // If non pre-emptive scheduler, don't change threads for pre-emption.
+    // (Don't change context until the current thread is non-runnable)
+#ifdef CONFIG_RTOS_COOPERATIVE_SCHEDULING
+    if (preempt && _current_thread->state == THREAD_RUNABLE)
+    {
+        API_STATS_END(API_STATS_THREAD_LOAD_CONTEXT);
+        return;
+    }
+#endif
+
+    // Scheduler locked by the (still run-able) current thread, defer
+    // until thread_sched_unlock
+    if (_current_thread && _current_thread->sched_lock && _current_thread->state == THREAD_RUNABLE)
+    {
+        _sched_pending = 1;
+        API_STATS_END(API_STATS_THREAD_LOAD_CONTEXT);
+        return;
+    }
+
+    _sched_pending = 0;
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    // How long was this thread scheduled for?
+    thread_charge_run_time(_current_thread, cpu_timenow());
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    // Charge the CPU budget (may demote the current thread)
+    thread_reservation_charge(cpu_timenow());
+#endif
+
+    // Fast path: nothing to switch to or round-robin with
+    if (thread_keep_current())
+    {
+        API_STATS_END(API_STATS_THREAD_LOAD_CONTEXT);
+        return;
+    }
+
+    // Now pick the highest thread that can be run and restore it's context.
+    pThread = thread_pick();
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    // Take a snapshot of the system clock when thread selected
+    pThread->run_start = cpu_timenow();
+
+    // Time=0 has a special meaning!
+    if (pThread->run_start == 0)
+        pThread->run_start = 1;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    // Thread picked after being woken, record how long it waited
+    if (pThread->ready_time != 0)
+        thread_wake_record(pThread);
+#endif
+
+    // Stop the outgoing thread's profiling clock and restart the new one's
+    if (pThread != _current_thread)
+    {
+        FUNC_PROFILE_SWITCH(_current_thread, pThread);
+#ifdef CONFIG_RTOS_API_STATS
+        thread_api_switch(_current_thread, pThread);
+#endif
+    }
+
+    // Load new thread's context
+    _current_thread = pThread;
+
+    API_STATS_END(API_STATS_THREAD_LOAD_CONTEXT);
+}
+//-----------------------------------------------------------------
+// thread_current: Get the current thread that is active!
+//-----------------------------------------------------------------
+struct thread* thread_current()
+{
+    return _current_thread;
+}
+//-----------------------------------------------------------------
+// thread_sched_lock: Defer preemption of the current thread by other
+// threads (wakeups, tick, IRQs) until the matching thread_sched_unlock.
+// Nestable. Unlike critical_start, interrupts stay enabled; they just
+// cannot switch threads. The lock belongs to the thread, so if it
+// blocks or sleeps other threads run as normal until it resumes.
+//-----------------------------------------------------------------
+void thread_sched_lock(void)
+{
+    OS_ASSERT(_current_thread != NULL);
+
+    // Only modified by the thread itself (ISRs just read it)
+    _current_thread->sched_lock++;
+}
+//-----------------------------------------------------------------
+// thread_sched_unlock: Release the scheduler lock, switching to a
+// higher priority thread made run-able while it was held
+//-----------------------------------------------------------------
+void thread_sched_unlock(void)
+{
+    int cr = critical_start();
+
+    OS_ASSERT(_current_thread->sched_lock > 0);
+
+    if (--_current_thread->sched_lock == 0 && _sched_pending)
+        thread_switch();
+
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// thread_keep_current: Check if the current thread would be picked
+// again without changing the run list, i.e. it is still run-able, at
+// the head of the run list (nothing higher priority became ready) and
+// is not due to move behind another thread of the same priority.
+// If so count the pick.
+// Returns: 1 if the current thread should keep running
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC int thread_keep_current(void)
+{
+    struct link_node *node;
+    struct thread *pNext;
+
+    if (!_current_thread || _current_thread->state != THREAD_RUNABLE)
+        return 0;
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    // A run-able slot owner runs regardless of priority
+    if (_cyclic_thread && _cyclic_thread->state == THREAD_RUNABLE)
+    {
+        if (_cyclic_thread != _current_thread)
+            return 0;
+    }
+    else
+#endif
+    if (thread_ready_first() != _current_thread)
+    {
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+        // Not above the current thread's preemption threshold
+        if (!thread_below_threshold(thread_ready_first()))
+#endif
+        return 0;
+    }
+
+    // Yield / end of time slice with an equal priority peer to rotate with?
+    // (EDF threads are ordered by deadline only)
+    node = THREAD_IS_EDF(_current_thread) ? NULL : list_next(&_thread_runnable, &_current_thread->node);
+    if (_thread_rotate && node)
+    {
+        pNext = list_entry(node, struct thread, node);
+        if (pNext->priority == _current_thread->priority)
+            return 0;
+    }
+
+    _thread_rotate = 0;
+
+    if (_current_thread->quantum_left == 0)
+        _current_thread->quantum_left = _current_thread->quantum;
+
+    _current_thread->run_count++;
+    _thread_picks++;
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// thread_pick: Pick the highest priority runable thread
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC struct thread* thread_pick(void)
+{
+    struct thread *pThread;
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    // Time-triggered slot owner is dispatched without a priority search
+    if (_cyclic_thread && _cyclic_thread->state == THREAD_RUNABLE)
+    {
+        _thread_rotate = 0;
+        _cyclic_thread->run_count++;
+        _thread_picks++;
+        return _cyclic_thread;
+    }
+#endif
+
+    // If the current thread is still run-able and has yielded or used
+    // up its time slice, move it in the run list.
+    // Otherwise (e.g. preempted) it stays ahead of its equal priority peers.
+    if (_current_thread && _current_thread->state == THREAD_RUNABLE && _thread_rotate && !THREAD_IS_EDF(_current_thread))
+    {
+        // Remove it from the run list
+        list_remove(&_thread_runnable, &_current_thread->node);
+        // and re-insert at appropriate position in run list
+        // based on thread priority.
+        // This will be after all the other threads at the same
+        // priority level, hence allowing round robin execution
+        // of other threads with the same priority level.
+        thread_insert_priority(&_thread_runnable, _current_thread);
+    }
+
+    _thread_rotate = 0;
+
+    // Get the first runable thread
+    pThread = thread_ready_first();
+
+    // We should have found a task to run as long as there is at least one
+    // task on the run list (there should be as this is why we have the idle
+    // task!).
+    OS_ASSERT(pThread != NULL);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    OS_ASSERT(pThread->state == THREAD_RUNABLE);
+
+    // Start a new time slice once the last one has been used
+    if (pThread->quantum_left == 0)
+        pThread->quantum_left = pThread->quantum;
+
+    pThread->run_count++;
+
+    // Total thread context switches / timer ticks have occurred
+    _thread_picks++;
+
+    return pThread;
+}
+//-----------------------------------------------------------------
+// thread_tick: Kernel tick handler
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_tick(void)
+{
+#ifdef CONFIG_RTOS_ISR_DEFER
+    _tick_pending++;
+
+    // Interrupted a thread updating the kernel lists, the tick is
+    // applied when it releases the kernel lock
+    if (thread_kernel_locked())
+    {
+        _isr_stats.ticks_deferred++;
+        return;
+    }
+
+    thread_kernel_catchup();
+#else
+    thread_tick_int();
+#endif
+}
+//-----------------------------------------------------------------
+// thread_tick_int: Kernel tick processing
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_tick_int(void)
+{
+    struct thread *pThread = NULL;
+#ifndef CONFIG_RTOS_TICK_WAKE_BATCH
+    struct link_node *node;
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+    uint64_t current_time = cpu_timenow();
+#endif
+#endif
+    API_STATS_BEGIN();
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+    _tick_lag++;
+#endif
+
+    // Bounded number of wakeups, the rest spill into the deferred pass
+    if (thread_sleep_expire(THREAD_TICK_WAKE_MAX))
+    {
+        _tick_wake_spills++;
+        if (_tick_wake_waiting)
+        {
+            _tick_wake_waiting = 0;
+            thread_unblock_int(&_tick_wake_thread);
+        }
+    }
+#else
+    // Get the first sleeping thread
+    node = list_first(&_thread_sleeping);
+    pThread = list_entry(node, struct thread, node);
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+    // Decrement a tick from the first item in the list
+    if (pThread && pThread->wait_delta)
+        pThread->wait_delta--;
+#endif
+
+    // Iterate through list of sleeping threads
+    while (pThread != NULL)
+    {
+        OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+        OS_ASSERT(pThread->state == THREAD_SLEEPING);
+
+        // Has this item timed out?
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+        if (current_time >= pThread->wakeup_time)
+#else
+        if (pThread->wait_delta == 0)
+#endif
+        {
+            // Remove from the sleep list
+            list_remove(&_thread_sleeping, &pThread->node);
+
+            // Add to the run list and mark runable
+            pThread->state = THREAD_RUNABLE;
+            THREAD_MARK_READY(pThread);
+            thread_ready_add(pThread);
+
+            // Get next node (new first node)
+            node = list_first(&_thread_sleeping);
+            pThread = list_entry(node, struct thread, node);
+        }
+        // Non-zero timeout remaining, end of timed out items
+        else
+            break;
+    }
+#endif
+
+    // Round-robin time slice of the interrupted thread
+    pThread = _current_thread;
+    if (pThread && pThread->state == THREAD_RUNABLE && THREAD_TIME_SLICED(pThread))
+    {
+        if (pThread->quantum_left > 0)
+            pThread->quantum_left--;
+
+        if (pThread->quantum_left == 0)
+            _thread_rotate = 1;
+    }
+
+    // Thats all, thread_load_context() will do the pick
+    // of the highest priority runable task...
+
+    _tick_count++;
+
+#ifdef INCLUDE_OS_TIMER
+    // Software timers share the sleep time base
+    os_timer_tick();
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+    thread_edf_check_misses();
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    thread_reservation_replenish();
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    thread_cyclic_tick();
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    // End of load average window? Fold it in over the next few ticks
+    if (++_load_window_ticks >= THREAD_LOAD_WINDOW)
+    {
+        _load_window_ticks = 0;
+        if (_load_update_next == NULL)
+            _load_update_next = _thread_list_all;
+    }
+
+    if (_load_update_next)
+        thread_load_update();
+#endif
+
+    API_STATS_END(API_STATS_THREAD_TICK);
+}
+//-----------------------------------------------------------------
+// thread_tick_count: Get the tick count for the RTOS
+//-----------------------------------------------------------------
+uint32_t thread_tick_count(void)
+{
+    return _tick_count;
+}
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+//-----------------------------------------------------------------
+// thread_sleep_expire: Make up to 'max' expired sleepers run-able,
+// merging them into the run list in a single pass
+// Returns: 1 if expired sleepers remain
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC int thread_sleep_expire(int max)
+{
+    struct link_list batch;
+    struct link_node *node;
+    struct thread *pThread;
+    int count = 0;
+    int more = 0;
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+    uint64_t current_time = cpu_timenow();
+#endif
+
+    list_init(&batch);
+
+    while ((node = list_first(&_thread_sleeping)) != NULL)
+    {
+        pThread = list_entry(node, struct thread, node);
+
+        OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+        OS_ASSERT(pThread->state == THREAD_SLEEPING);
+
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+        if (current_time < pThread->wakeup_time)
+            break;
+#else
+        // Take the outstanding ticks off the head, stop at the first
+        // thread with time remaining
+        if (pThread->wait_delta > _tick_lag)
+        {
+            pThread->wait_delta -= _tick_lag;
+            _tick_lag = 0;
+            break;
+        }
+
+        _tick_lag -= pThread->wait_delta;
+        pThread->wait_delta = 0;
+#endif
+
+        // Expired, but this pass has done enough
+        if (count == max)
+        {
+            more = 1;
+            break;
+        }
+
+        list_remove(&_thread_sleeping, node);
+        pThread->state = THREAD_RUNABLE;
+        THREAD_MARK_READY(pThread);
+
+        // Priority order the (short) batch, EDF threads go to the heap
+        if (THREAD_IS_EDF(pThread))
+            thread_ready_add(pThread);
+        else
+            thread_insert_priority(&batch, pThread);
+        count++;
+    }
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+    // Nothing left sleeping to owe ticks to
+    if (node == NULL)
+        _tick_lag = 0;
+#endif
+
+    thread_ready_add_batch(&batch);
+    return more;
+}
+//-----------------------------------------------------------------
+// thread_ready_add_batch: Merge a priority ordered batch of threads
+// into the run list with one walk of the list
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_ready_add_batch(struct link_list *batch)
+{
+    struct link_node *pos = list_first(&_thread_runnable);
+    struct link_node *node;
+    struct thread *pThread;
+    struct thread *pOther;
+
+    while ((node = list_first(batch)) != NULL)
+    {
+        pThread = list_entry(node, struct thread, node);
+        list_remove(batch, node);
+
+        // Skip to the end of this thread's priority level. Later batch
+        // entries are no higher priority so never need to look back.
+        while (pos)
+        {
+            pOther = list_entry(pos, struct thread, node);
+            if (pThread->priority > pOther->priority)
+                break;
+            pos = list_next(&_thread_runnable, pos);
+        }
+
+        if (pos)
+            list_insert_before(&_thread_runnable, pos, node);
+        else
+            list_insert_last(&_thread_runnable, node);
+    }
+}
+//-----------------------------------------------------------------
+// thread_tick_wake_task: Deferred pass waking expired sleepers which
+// did not fit in the tick interrupt, a batch at a time
+//-----------------------------------------------------------------
+static void *thread_tick_wake_task(void* arg)
+{
+    int cr;
+
+    while (1)
+    {
+        cr = critical_start();
+
+        // Nothing more expired, wait for a tick to spill again
+        if (!thread_sleep_expire(THREAD_TICK_WAKE_MAX))
+        {
+            _tick_wake_waiting = 1;
+            thread_block(&_tick_wake_thread);
+        }
+
+        critical_end(cr);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// thread_tick_wake_spills: Number of ticks which spilled wakeups
+// into the deferred pass
+//-----------------------------------------------------------------
+uint32_t thread_tick_wake_spills(void)
+{
+    return _tick_wake_spills;
+}
+#endif
+//-----------------------------------------------------------------
+// thread_func: Wrapper for thread entry point
+//-----------------------------------------------------------------
+static void thread_func(void *pThd)
+{
+    struct thread *pThread = (struct thread *)pThd;
+    void *ret_arg;
+
+    OS_ASSERT(pThread);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+
+    // Execute thread function
+    ret_arg = pThread->thread_func(pThread->thread_arg);
+
+    // Now thread has exited, call thread_suicide!
+    thread_suicide(pThread, ret_arg);
+    
+    // We should never reach here!
+    OS_PANIC("Should not be here");
+}
+//-----------------------------------------------------------------
+// thread_block: Block specified thread from executing
+// WARNING: Call within critical section!
+//-----------------------------------------------------------------
+void thread_block(struct thread *pThread)
+{
+    API_STATS_BEGIN();
+
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    OS_ASSERT(pThread->state == THREAD_RUNABLE);
 
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-                // Adjust next nodes delta time
-                pThread->wait_delta -= pSleepThread->wait_delta;
-#endif
-                break;
-            }
+    // Mark thread as blocked
+    pThread->state = THREAD_BLOCKED;
 
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-            prevtotal = total;
-#endif
+    // Remove from the run list
+    thread_ready_remove(pThread);
 
-            // End of list reached, still not added
-            if (list_next(&_thread_sleeping, node) == NULL)
-            {
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-                // delta time from previous to this node
-                pSleepThread->wait_delta = time_units - prevtotal;
-#endif
+    // Add to the blocked list
+    list_insert_last(&_thread_blocked, &pThread->node);
 
-                // Insert into list after last node (end of list)
-                list_insert_last(&_thread_sleeping, &pSleepThread->node);
-                break;
-            }
-        }
-    }
+    // Switch context to the new highest priority thread
+    thread_switch();
 
-    critical_end(cr);
+    API_STATS_END(API_STATS_THREAD_BLOCK);
 }
 //-----------------------------------------------------------------
-// thread_sleep_cancel: Stop a thread from sleeping
+// thread_unblock_int: Unblock specified thread. Internal function.
+// Manipulates the ready/blocked/sleeping lists only.
+// WARNING: Call within critical section!
 //-----------------------------------------------------------------
-void thread_sleep_cancel(struct thread *pThread)
+static void thread_unblock_int(struct thread *pThread)
 {
-    int cr = critical_start();
-
-    OS_ASSERT(pThread);
+    // WARNING: There is no gaurantee that unblock is not called
+    // on a thread that is already runable.
+    // This is due to a timed semaphore timing out, being made
+    // runable again but that thread not being scheduled prior
+    // to the post operation which will unblock it...
 
-    // If the item has not already expired (and is in the sleeping list)
+#ifdef CONFIG_RTOS_HRTIMER
+    // High resolution sleep (the one-shot timer may still fire, harmlessly)
+    if (THREAD_HR_SLEEPING(pThread))
+        thread_hrsleep_remove(pThread);
+    else
+#endif
+    // Is thread sleeping (i.e doing a timed pend using thread_sleep)?
     if (pThread->state == THREAD_SLEEPING)
     {
 #ifndef CONFIG_RTOS_ABSOLUTE_TIME
-        // Is there another thread after this in the delta list?
+        // Is there another thread after this in the delta sleeping list?
         struct link_node *node = list_next(&_thread_sleeping, &pThread->node);
         if (node)
         {
@@ -448,325 +2237,688 @@ void thread_sleep_cancel(struct thread *pThread)
         // Clear the sleep timer
         pThread->wait_delta = 0;
 #endif
-
         // Remove from the sleeping list
         list_remove(&_thread_sleeping, &pThread->node);
-
-        // Until this thread is put back in the run list or
-        // is re-added to the sleep list then mark as blocked.
-        pThread->state = THREAD_BLOCKED;
-        list_insert_last(&_thread_blocked, &pThread->node);
     }
-    // Else thread timeout has expired and is now runable (or blocked)
+    // Is the thread in the blocked list
+    else if (pThread->state == THREAD_BLOCKED)
+    {
+        // Remove from the blocked list
+        list_remove(&_thread_blocked, &pThread->node);
+    }
+    // Already in the run list, exit!
+    else if (pThread->state == THREAD_RUNABLE)
+        return ;
 
-    critical_end(cr);
+    // Mark thread as run-able
+    pThread->state = THREAD_RUNABLE;
+    THREAD_MARK_READY(pThread);
+
+    // Add to the run list
+    thread_ready_add(pThread);
 }
 //-----------------------------------------------------------------
-// thread_sleep: Sleep thread for x time units
+// thread_unblock: Unblock specified thread / enable execution
+// WARNING: Call within critical section!
 //-----------------------------------------------------------------
-void thread_sleep(uint32_t time_units)
+void thread_unblock(struct thread *pThread)
+{
+    API_STATS_BEGIN();
+
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+
+    // Make sure thread is now in the run list
+    thread_unblock_int(pThread);
+
+    // If un-blocked thread is higher priority than this thread
+    // then switch context to the new highest priority thread
+    if (thread_preempts(pThread, _current_thread))
+        thread_switch();
+
+    API_STATS_END(API_STATS_THREAD_UNBLOCK);
+}
+//-----------------------------------------------------------------
+// thread_unblock_irq: Unblock thread from IRQ
+//-----------------------------------------------------------------
+void thread_unblock_irq(struct thread *pThread)
 {
+    API_STATS_BEGIN();
+
+    // Critical section should not be required, but for sanity
     int cr = critical_start();
 
-    // Put the current thread to sleep
-    if (time_units > 0)
-        thread_sleep_thread(_current_thread, time_units);
+    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
 
-    // Switch context to the next highest priority thread
-    thread_switch();
+#ifdef CONFIG_RTOS_ISR_DEFER
+    // Leave the list manipulation to the kernel
+    if (thread_isr_defer(thread_unblock_deferred, pThread))
+        cpu_context_switch_irq();
+#else
+    // Make sure thread is now in the run list
+    thread_unblock_int(pThread);
+
+    // Schedule a context switch to occur after IRQ completes
+    cpu_context_switch_irq();
+#endif
 
     critical_end(cr);
+
+    API_STATS_END(API_STATS_THREAD_UNBLOCK_IRQ);
 }
+#ifdef CONFIG_RTOS_ISR_DEFER
 //-----------------------------------------------------------------
-// thread_switch: Switch context to the highest priority thread
+// thread_unblock_deferred: Queued thread_unblock_irq request
 //-----------------------------------------------------------------
-static void thread_switch(void)
+static void thread_unblock_deferred(void *arg)
 {
-    // Get the current run count
-    uint32_t oldRuncount = _current_thread->run_count;
+    thread_unblock_int((struct thread *)arg);
+}
+//-----------------------------------------------------------------
+// thread_isr_defer: Kernel request from interrupt context.
+// Queued without touching the kernel lists, the request is applied on
+// interrupt exit, or when the interrupted thread releases the kernel
+// lock. Requests made while applying others act straight away.
+// If the queue is full the older requests are applied, then this one.
+// This is not possible while the interrupted thread holds the kernel
+// lock, so THREAD_ISR_QUEUE_ENTRIES must cover the worst case burst.
+// Returns: 1 if the kernel should run on interrupt exit (0 if applied
+// or the kernel is already catching up)
+//-----------------------------------------------------------------
+int thread_isr_defer(void (*func)(void *arg), void *arg)
+{
+    struct thread_isr_request *req;
+    uint32_t idx = _isr_head;
+    uint32_t depth = idx - _isr_tail;
 
-    // Cause context switch
-    cpu_context_switch();
+    OS_ASSERT(func != NULL);
 
-    // In-order to get back to this point, we must have been
-    // picked by thread_pick() and the run-count incremented.
-    OS_ASSERT(oldRuncount != (_current_thread->run_count));
+    if (_isr_processing)
+    {
+        func(arg);
+        return 0;
+    }
 
-    // This thread must be in the run list otherwise something has gone wrong!
-    OS_ASSERT(_current_thread->state == THREAD_RUNABLE);
+    if (depth >= THREAD_ISR_QUEUE_ENTRIES)
+    {
+        // Kernel lists are mid-update, the request cannot be applied
+        // or dropped
+        if (thread_kernel_locked() && !_kernel_catchup)
+            OS_PANIC("ISR queue full");
+
+        _isr_stats.overflows++;
+
+        // Keep requests in order
+        thread_isr_process();
+
+        _isr_processing = 1;
+        func(arg);
+        _isr_processing = 0;
+        return !_kernel_catchup;
+    }
+
+    req = &_isr_queue[idx & (THREAD_ISR_QUEUE_ENTRIES - 1)];
+    req->func = func;
+    req->arg = arg;
+
+    // Publish the request to the kernel
+    _isr_head = idx + 1;
+
+    _isr_stats.requests++;
+    if (depth + 1 > _isr_stats.depth_max)
+        _isr_stats.depth_max = depth + 1;
+
+    return !_kernel_catchup;
 }
 //-----------------------------------------------------------------
-// thread_load_context: Find highest priority run-able thread to run
+// thread_isr_process: Apply all queued ISR requests in order
+// NOTE: Must be called within critical protection region (or INT)
 //-----------------------------------------------------------------
-CRITICALFUNC void thread_load_context(int preempt)
+static CRITICALFUNC void thread_isr_process(void)
 {
-    struct thread * pThread;
+    struct thread_isr_request *req;
 
-    // If non pre-emptive scheduler, don't change threads for pre-emption.
-    // (Don't change context until the current thread is non-runnable)
-#ifdef CONFIG_RTOS_COOPERATIVE_SCHEDULING
-    if (preempt && _current_thread->state == THREAD_RUNABLE)
+    _isr_processing = 1;
+
+    while (_isr_tail != _isr_head)
+    {
+        req = &_isr_queue[_isr_tail & (THREAD_ISR_QUEUE_ENTRIES - 1)];
+        req->func(req->arg);
+        _isr_tail++;
+    }
+
+    _isr_processing = 0;
+}
+//-----------------------------------------------------------------
+// thread_kernel_locked: Is the current thread updating kernel lists?
+// (if so interrupts must leave them alone)
+//-----------------------------------------------------------------
+static CRITICALFUNC int thread_kernel_locked(void)
+{
+    return _current_thread && _current_thread->kernel_lock;
+}
+//-----------------------------------------------------------------
+// thread_kernel_catchup: Apply queued ISR requests, ticks and timer
+// expiries held off by the kernel lock
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_kernel_catchup(void)
+{
+    _kernel_catchup = 1;
+
+    // Requests first, they arrived no later than the tick which
+    // may queue more (tick context timers)
+    while (1)
+    {
+        thread_isr_process();
+
+        if (_tick_pending)
+        {
+            _tick_pending--;
+            thread_tick_int();
+        }
+#ifdef CONFIG_RTOS_HRTIMER
+        else if (_hrtimer_pending)
+        {
+            _hrtimer_pending = 0;
+            thread_hrtimer_int();
+        }
+#endif
+        else
+            break;
+    }
+
+    _kernel_catchup = 0;
+}
+//-----------------------------------------------------------------
+// thread_kernel_lock: Protect kernel lists and objects from other
+// threads and from interrupts without masking them. Interrupts only
+// queue requests and note ticks while it is held; these are applied
+// by thread_kernel_unlock. Nestable, held per thread (like the
+// scheduler lock) so blocking with it held is fine.
+// Returns: value to pass to thread_kernel_unlock
+//-----------------------------------------------------------------
+int thread_kernel_lock(void)
+{
+    struct thread *pThread = _current_thread;
+    int cr;
+
+    // Not started yet, or the kernel is running on behalf of interrupts
+    // (which are masked)
+    if (pThread == NULL || _isr_processing || _kernel_catchup)
+        return 0;
+
+    pThread->kernel_lock++;
+
+    // Requests queued by interrupts since the last kernel exit (e.g. a
+    // port which does not run the kernel on every interrupt exit) are
+    // applied first, so the caller sees up to date objects
+    if (pThread->kernel_lock == 1 && _isr_head != _isr_tail)
+    {
+        cr = critical_start();
+        thread_kernel_catchup();
+        _kernel_resched = 1;
+        critical_end(cr);
+    }
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// thread_kernel_unlock: Release the kernel lock. On the outermost
+// release apply whatever interrupts held off and switch to a higher
+// priority thread this made run-able.
+//-----------------------------------------------------------------
+void thread_kernel_unlock(int locked)
+{
+    struct thread *pThread = _current_thread;
+    int cr;
+
+    if (!locked)
+        return;
+
+    OS_ASSERT(pThread->kernel_lock > 0);
+
+    if (pThread->kernel_lock > 1)
+    {
+        pThread->kernel_lock--;
         return;
+    }
+
+    // Interrupts held off until now must see the lock released
+    cr = critical_start();
+
+    pThread->kernel_lock = 0;
+
+    if (_kernel_resched || _tick_pending || _isr_head != _isr_tail
+#ifdef CONFIG_RTOS_HRTIMER
+        || _hrtimer_pending
 #endif
+        )
+    {
+        thread_kernel_catchup();
 
-#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
-    // How long was this thread scheduled for?
-    if (_current_thread->run_start != 0)
-        _current_thread->run_time += cpu_timediff(cpu_timenow(), _current_thread->run_start);
+#ifdef CONFIG_RTOS_COOPERATIVE_SCHEDULING
+        _kernel_resched = 0;
+#else
+        thread_switch();
 #endif
+    }
 
-    // Now pick the highest thread that can be run and restore it's context.
-    pThread = thread_pick();
+    critical_end(cr);
+}
+//-----------------------------------------------------------------
+// thread_isr_defer_stats: Get ISR request queue statistics
+//-----------------------------------------------------------------
+void thread_isr_defer_stats(struct thread_isr_queue_stats *stats)
+{
+    int cr;
 
-#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
-    // Take a snapshot of the system clock when thread selected
-    pThread->run_start = cpu_timenow();
+    OS_ASSERT(stats != NULL);
 
-    // Time=0 has a special meaning!
-    if (pThread->run_start == 0)
-        pThread->run_start = 1;
+    cr = critical_start();
+    *stats = _isr_stats;
+    critical_end(cr);
+}
 #endif
+//-----------------------------------------------------------------
+// thread_change_priority: Change the priority used for scheduling,
+// moving a run-able thread to the end of its new priority level.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_change_priority(struct thread *pThread, int pri)
+{
+    if (pThread->priority == pri)
+        return;
 
-    // Load new thread's context
-    _current_thread = pThread;
+    pThread->priority = pri;
+
+    if (pThread->state == THREAD_RUNABLE)
+    {
+        list_remove(&_thread_runnable, &pThread->node);
+        thread_insert_priority(&_thread_runnable, pThread);
+    }
+}
+//-----------------------------------------------------------------
+// thread_ready_add: Add a run-able thread to the run list (or the EDF
+// ready heap)
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_ready_add(struct thread *pThread)
+{
+#ifdef CONFIG_RTOS_EDF
+    if (THREAD_IS_EDF(pThread))
+    {
+        thread_edf_insert(pThread);
+        return;
+    }
+#endif
+    thread_insert_priority(&_thread_runnable, pThread);
 }
 //-----------------------------------------------------------------
-// thread_current: Get the current thread that is active!
+// thread_ready_remove: Remove a thread from the run list (or the EDF
+// ready heap)
+// NOTE: Must be called within critical protection region
 //-----------------------------------------------------------------
-struct thread* thread_current()
+static CRITICALFUNC void thread_ready_remove(struct thread *pThread)
 {
-    return _current_thread;
+#ifdef CONFIG_RTOS_EDF
+    if (THREAD_IS_EDF(pThread))
+    {
+        thread_edf_remove(pThread);
+        return;
+    }
+#endif
+    list_remove(&_thread_runnable, &pThread->node);
 }
 //-----------------------------------------------------------------
-// thread_pick: Pick the highest priority runable thread
+// thread_ready_first: Best run-able thread. The earliest deadline EDF
+// thread runs unless a fixed priority thread above THREAD_EDF_PRIO is
+// run-able.
 // NOTE: Must be called within critical protection region
 //-----------------------------------------------------------------
-static CRITICALFUNC struct thread* thread_pick(void)
+static CRITICALFUNC struct thread* thread_ready_first(void)
 {
+    struct link_node *node = list_first(&_thread_runnable);
     struct thread *pThread;
-    struct link_node *node;
-
-    // If we have a current running task and if the current thread
-    // is still run-able, put it in the correct position in the list.
-    if (_current_thread && _current_thread->state == THREAD_RUNABLE)
-    {
-        // Remove it from the run list
-        list_remove(&_thread_runnable, &_current_thread->node);
-        // and re-insert at appropriate position in run list
-        // based on thread priority.
-        // This will be after all the other threads at the same
-        // priority level, hence allowing round robin execution
-        // of other threads with the same priority level.
-        thread_insert_priority(&_thread_runnable, _current_thread);
-    }
 
-    // Get the first runable thread
-    node = list_first(&_thread_runnable);
+    // There is always at least the idle task
     OS_ASSERT(node != NULL);
-
     pThread = list_entry(node, struct thread, node);
 
-    // We should have found a task to run as long as there is at least one
-    // task on the run list (there should be as this is why we have the idle
-    // task!).
-    OS_ASSERT(pThread != NULL);
-    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
-    OS_ASSERT(pThread->state == THREAD_RUNABLE);
-
-    pThread->run_count++;
-
-    // Total thread context switches / timer ticks have occurred
-    _thread_picks++;
+#ifdef CONFIG_RTOS_EDF
+    if (_edf_ready > 0 && pThread->priority <= THREAD_EDF_PRIO)
+        pThread = _edf_heap[0];
+#endif
 
     return pThread;
 }
 //-----------------------------------------------------------------
-// thread_tick: Kernel tick handler
-// NOTE: Must be called within critical protection region (or INT)
+// thread_preempts: Should pThread run in preference to pOther?
 //-----------------------------------------------------------------
-CRITICALFUNC void thread_tick(void)
+static CRITICALFUNC int thread_preempts(struct thread *pThread, struct thread *pOther)
 {
-    struct thread *pThread = NULL;
-    struct link_node *node;
-#ifdef CONFIG_RTOS_ABSOLUTE_TIME
-    uint64_t current_time = cpu_timenow();
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+    if (pOther == _current_thread && thread_below_threshold(pThread))
+        return 0;
+#endif
+#ifdef CONFIG_RTOS_EDF
+    if (THREAD_IS_EDF(pThread) && THREAD_IS_EDF(pOther))
+        return (int32_t)(pThread->deadline - pOther->deadline) < 0;
+    else if (THREAD_IS_EDF(pThread))
+        return pOther->priority <= THREAD_EDF_PRIO;
+#endif
+    return pThread->priority > pOther->priority;
+}
+//-----------------------------------------------------------------
+// thread_effective_priority: Priority a thread should be scheduled at,
+// given its set (base) priority, policy and CPU reservation
+//-----------------------------------------------------------------
+static CRITICALFUNC int thread_effective_priority(struct thread *pThread)
+{
+#ifdef CONFIG_RTOS_EDF
+    if (THREAD_IS_EDF(pThread))
+        return THREAD_EDF_PRIO;
+#endif
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    if (pThread->reservation && pThread->reservation->exhausted &&
+        pThread->reservation->demote_prio < pThread->base_priority)
+        return pThread->reservation->demote_prio;
 #endif
+    return pThread->base_priority;
+}
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+//-----------------------------------------------------------------
+// thread_cyclic_tick: End the current slot once its ticks have elapsed,
+// counting an overrun if the job did not complete, and release the next
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_cyclic_tick(void)
+{
+    const struct thread_cyclic_slot *slot;
+    struct thread *pThread;
 
-    // Get the first sleeping thread
-    node = list_first(&_thread_sleeping);
-    pThread = list_entry(node, struct thread, node);
+    if (!_cyclic_table || --_cyclic_slot_left > 0)
+        return;
 
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-    // Decrement a tick from the first item in the list
-    if (pThread && pThread->wait_delta)
-        pThread->wait_delta--;
-#endif
+    slot = &_cyclic_table[_cyclic_frame].slots[_cyclic_slot];
+    pThread = slot->thread;
 
-    // Iterate through list of sleeping threads
-    while (pThread != NULL)
+    if (pThread && !_cyclic_done)
     {
-        OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
-        OS_ASSERT(pThread->state == THREAD_SLEEPING);
+        if (_cyclic_stats)
+            _cyclic_stats[_cyclic_index].overruns++;
 
-        // Has this item timed out?
-#ifdef CONFIG_RTOS_ABSOLUTE_TIME
-        if (current_time >= pThread->wakeup_time)
-#else
-        if (pThread->wait_delta == 0)
-#endif
+        // Preempt the job until the thread's next slot
+        if (pThread->state == THREAD_RUNABLE)
         {
-            // Remove from the sleep list
-            list_remove(&_thread_sleeping, &pThread->node);
-
-            // Add to the run list and mark runable
-            pThread->state = THREAD_RUNABLE;
-            thread_insert_priority(&_thread_runnable, pThread);
+            thread_ready_remove(pThread);
+            pThread->state = THREAD_BLOCKED;
+            pThread->cyclic_state = THREAD_CYCLIC_SUSPENDED;
+            list_insert_last(&_thread_blocked, &pThread->node);
+        }
+    }
 
-            // Get next node (new first node)
-            node = list_first(&_thread_sleeping);
-            pThread = list_entry(node, struct thread, node);
+    // Next slot / minor frame / major frame
+    _cyclic_index++;
+    if (++_cyclic_slot >= _cyclic_table[_cyclic_frame].num_slots)
+    {
+        _cyclic_slot = 0;
+        if (++_cyclic_frame >= _cyclic_frames)
+        {
+            _cyclic_frame = 0;
+            _cyclic_index = 0;
         }
-        // Non-zero timeout remaining, end of timed out items
-        else
-            break;
     }
 
-    // Thats all, thread_load_context() will do the pick
-    // of the highest priority runable task...
+    thread_cyclic_release();
+}
+//-----------------------------------------------------------------
+// thread_cyclic_release: Start the current slot, making its thread
+// run-able if waiting for it
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_cyclic_release(void)
+{
+    const struct thread_cyclic_slot *slot = &_cyclic_table[_cyclic_frame].slots[_cyclic_slot];
+    struct thread *pThread = slot->thread;
 
-    _tick_count++;
+    _cyclic_slot_left = slot->ticks;
+    _cyclic_thread = pThread;
+    _cyclic_done = (pThread == NULL);
+
+    if (!pThread)
+        return;
+
+    if (_cyclic_stats)
+        _cyclic_stats[_cyclic_index].releases++;
+
+    if (pThread->state == THREAD_BLOCKED && pThread->cyclic_state != THREAD_CYCLIC_NONE)
+    {
+        list_remove(&_thread_blocked, &pThread->node);
+        pThread->cyclic_state = THREAD_CYCLIC_NONE;
+        pThread->state = THREAD_RUNABLE;
+        THREAD_MARK_READY(pThread);
+        thread_ready_add(pThread);
+    }
 }
+#endif
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
 //-----------------------------------------------------------------
-// thread_tick_count: Get the tick count for the RTOS
+// thread_below_threshold: Is thread prevented from preempting the
+// current thread by the current thread's preemption threshold?
 //-----------------------------------------------------------------
-uint32_t thread_tick_count(void)
+static CRITICALFUNC int thread_below_threshold(struct thread *pThread)
 {
-    return _tick_count;
+    int threshold = _current_thread->preempt_threshold;
+
+    return threshold > _current_thread->priority && pThread->priority <= threshold;
 }
+#endif
+#ifdef CONFIG_RTOS_CPU_RESERVATION
 //-----------------------------------------------------------------
-// thread_func: Wrapper for thread entry point
+// thread_reservation_charge: Charge the time since the last call to
+// the current thread's reservation, demoting its threads once the
+// budget is used up.
+// NOTE: Must be called within critical protection region (or INT)
 //-----------------------------------------------------------------
-static void thread_func(void *pThd)
+static CRITICALFUNC void thread_reservation_charge(uint64_t now)
 {
-    struct thread *pThread = (struct thread *)pThd;
-    void *ret_arg;
+    struct thread_reservation *res = _current_thread ? _current_thread->reservation : NULL;
+    uint64_t last = _res_start;
+    int64_t used;
 
-    OS_ASSERT(pThread);
-    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    // Time=0 has a special meaning (not started)!
+    _res_start = now ? now : 1;
 
-    // Execute thread function
-    ret_arg = pThread->thread_func(pThread->thread_arg);
+    if (!res || res->exhausted || last == 0)
+        return;
 
-    // Now thread has exited, call thread_suicide!
-    thread_suicide(pThread, ret_arg);
-    
-    // We should never reach here!
-    OS_PANIC("Should not be here");
+    used = cpu_timediff(now, last);
+    if (used < 0)
+        used = 0;
+
+    if ((uint64_t)used < res->remaining)
+    {
+        res->remaining -= (uint64_t)used;
+        return;
+    }
+
+    res->remaining = 0;
+    res->exhausted = 1;
+    res->exhaustions++;
+    thread_reservation_update(res);
 }
 //-----------------------------------------------------------------
-// thread_block: Block specified thread from executing
-// WARNING: Call within critical section!
+// thread_reservation_replenish: Restore the budget of reservations at
+// the start of their next period, promoting demoted threads again.
+// NOTE: Must be called within critical protection region (or INT)
 //-----------------------------------------------------------------
-void thread_block(struct thread *pThread)
+static CRITICALFUNC void thread_reservation_replenish(void)
 {
-    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
-    OS_ASSERT(pThread->state == THREAD_RUNABLE);
+    struct thread_reservation *res;
 
-    // Mark thread as blocked
-    pThread->state = THREAD_BLOCKED;
+    for (res = _reservations; res != NULL; res = res->next)
+    {
+        if ((int32_t)(_tick_count - res->next_replenish) < 0)
+            continue;
 
-    // Remove from the run list
-    list_remove(&_thread_runnable, &pThread->node);
+        res->next_replenish += res->period;
+        res->remaining = res->budget;
 
-    // Add to the blocked list
-    list_insert_last(&_thread_blocked, &pThread->node);
+        if (res->exhausted)
+        {
+            res->exhausted = 0;
+            thread_reservation_update(res);
+        }
+    }
+}
+//-----------------------------------------------------------------
+// thread_reservation_update: Re-evaluate the priority of all threads
+// charged to a reservation
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_reservation_update(struct thread_reservation *res)
+{
+    struct thread *pThread;
 
-    // Switch context to the new highest priority thread
-    thread_switch();
+    for (pThread = _thread_list_all; pThread != NULL; pThread = pThread->next_all)
+        if (pThread->reservation == res)
+            thread_change_priority(pThread, thread_effective_priority(pThread));
 }
+#endif
+#ifdef CONFIG_RTOS_EDF
 //-----------------------------------------------------------------
-// thread_unblock_int: Unblock specified thread. Internal function.
-// Manipulates the ready/blocked/sleeping lists only.
-// WARNING: Call within critical section!
+// thread_edf_before: Is thread a's deadline earlier than b's
+// (tick count wrap safe)
 //-----------------------------------------------------------------
-static void thread_unblock_int(struct thread *pThread)
+static CRITICALFUNC int thread_edf_before(struct thread *a, struct thread *b)
 {
-    // WARNING: There is no gaurantee that unblock is not called
-    // on a thread that is already runable.
-    // This is due to a timed semaphore timing out, being made
-    // runable again but that thread not being scheduled prior
-    // to the post operation which will unblock it...
+    return (int32_t)(a->deadline - b->deadline) < 0;
+}
+//-----------------------------------------------------------------
+// thread_edf_set: Place thread at a heap position
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_edf_set(int idx, struct thread *pThread)
+{
+    _edf_heap[idx] = pThread;
+    pThread->edf_index = idx;
+}
+//-----------------------------------------------------------------
+// thread_edf_sift_up: Move heap entry towards the root while its
+// deadline is earlier than its parent's
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_edf_sift_up(int idx)
+{
+    struct thread *pThread = _edf_heap[idx];
 
-    // Is thread sleeping (i.e doing a timed pend using thread_sleep)?
-    if (pThread->state == THREAD_SLEEPING)
+    while (idx > 0)
     {
-#ifndef CONFIG_RTOS_ABSOLUTE_TIME
-        // Is there another thread after this in the delta sleeping list?
-        struct link_node *node = list_next(&_thread_sleeping, &pThread->node);
-        if (node)
-        {
-            struct thread *pNextThread = list_entry(node, struct thread, node);
+        int parent = (idx - 1) / 2;
 
-            // Add current item's remaining time to next
-            pNextThread->wait_delta += pThread->wait_delta;
-        }
+        if (!thread_edf_before(pThread, _edf_heap[parent]))
+            break;
 
-        // Clear the sleep timer
-        pThread->wait_delta = 0;
-#endif
-        // Remove from the sleeping list
-        list_remove(&_thread_sleeping, &pThread->node);
+        thread_edf_set(idx, _edf_heap[parent]);
+        idx = parent;
     }
-    // Is the thread in the blocked list
-    else if (pThread->state == THREAD_BLOCKED)
+
+    thread_edf_set(idx, pThread);
+}
+//-----------------------------------------------------------------
+// thread_edf_sift_down: Move heap entry towards the leaves while a
+// child has an earlier deadline
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_edf_sift_down(int idx)
+{
+    struct thread *pThread = _edf_heap[idx];
+
+    while (1)
     {
-        // Remove from the blocked list
-        list_remove(&_thread_blocked, &pThread->node);
+        int child = (idx * 2) + 1;
+
+        if (child >= _edf_ready)
+            break;
+
+        // Earlier of the two children
+        if (child + 1 < _edf_ready && thread_edf_before(_edf_heap[child + 1], _edf_heap[child]))
+            child++;
+
+        if (!thread_edf_before(_edf_heap[child], pThread))
+            break;
+
+        thread_edf_set(idx, _edf_heap[child]);
+        idx = child;
     }
-    // Already in the run list, exit!
-    else if (pThread->state == THREAD_RUNABLE)
-        return ;
 
-    // Mark thread as run-able
-    pThread->state = THREAD_RUNABLE;
+    thread_edf_set(idx, pThread);
+}
+//-----------------------------------------------------------------
+// thread_edf_insert: Add thread to the EDF ready heap
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_edf_insert(struct thread *pThread)
+{
+    OS_ASSERT(pThread->edf_index < 0);
+    OS_ASSERT(_edf_ready < THREAD_EDF_MAX);
 
-    // Add to the run list
-    thread_insert_priority(&_thread_runnable, pThread);
+    thread_edf_set(_edf_ready++, pThread);
+    thread_edf_sift_up(pThread->edf_index);
 }
 //-----------------------------------------------------------------
-// thread_unblock: Unblock specified thread / enable execution
-// WARNING: Call within critical section!
+// thread_edf_remove: Remove thread from the EDF ready heap
+// NOTE: Must be called within critical protection region
 //-----------------------------------------------------------------
-void thread_unblock(struct thread *pThread)
+static CRITICALFUNC void thread_edf_remove(struct thread *pThread)
 {
-    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    int idx = pThread->edf_index;
+    struct thread *pLast;
 
-    // Make sure thread is now in the run list
-    thread_unblock_int(pThread);
+    OS_ASSERT(idx >= 0 && idx < _edf_ready);
 
-    // If un-blocked thread is higher priority than this thread
-    // then switch context to the new highest priority thread
-    if (pThread->priority > _current_thread->priority)
-        thread_switch();
+    pThread->edf_index = -1;
+    pLast = _edf_heap[--_edf_ready];
+
+    // Fill the hole with the last entry and restore heap order
+    if (pLast != pThread)
+    {
+        thread_edf_set(idx, pLast);
+        thread_edf_update(pLast);
+    }
 }
 //-----------------------------------------------------------------
-// thread_unblock_irq: Unblock thread from IRQ
+// thread_edf_update: Restore heap order after a deadline change
+// NOTE: Must be called within critical protection region
 //-----------------------------------------------------------------
-void thread_unblock_irq(struct thread *pThread)
+static CRITICALFUNC void thread_edf_update(struct thread *pThread)
 {
-    // Critical section should not be required, but for sanity
-    int cr = critical_start();
-
-    OS_ASSERT(pThread->checkword == THREAD_CHECK_WORD);
+    thread_edf_sift_up(pThread->edf_index);
+    thread_edf_sift_down(pThread->edf_index);
+}
+//-----------------------------------------------------------------
+// thread_edf_check_misses: Count run-able EDF threads whose deadline
+// has passed (once per deadline)
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_edf_check_misses(void)
+{
+    int i;
 
-    // Make sure thread is now in the run list
-    thread_unblock_int(pThread);
+    // Nothing overdue if the earliest deadline has not passed
+    if (_edf_ready == 0 || (int32_t)(_tick_count - _edf_heap[0]->deadline) <= 0)
+        return;
 
-    // Schedule a context switch to occur after IRQ completes
-    cpu_context_switch_irq();
+    for (i=0;i<_edf_ready;i++)
+    {
+        struct thread *pThread = _edf_heap[i];
 
-    critical_end(cr);
+        if (!pThread->deadline_missed && (int32_t)(_tick_count - pThread->deadline) > 0)
+        {
+            pThread->deadline_missed = 1;
+            pThread->deadline_misses++;
+            _edf_misses++;
+        }
+    }
 }
+#endif
 //-----------------------------------------------------------------
 // thread_insert_priority: Insert thread into list in priority order
 //-----------------------------------------------------------------
@@ -819,47 +2971,160 @@ static void *thread_idle_task(void* arg)
     return NULL;
 }
 //-----------------------------------------------------------------
+// thread_state_char: Single character thread state (debug output)
+//-----------------------------------------------------------------
+static char thread_state_char(tThreadState state, int current)
+{
+    if (current)
+        return '*';
+
+    switch (state)
+    {
+        case THREAD_RUNABLE:
+            return 'R';
+        case THREAD_SLEEPING:
+            return 'S';
+        case THREAD_BLOCKED:
+            return 'B';
+        case THREAD_DEAD:
+            return 'X';
+        default:
+            return 'U';
+    }
+}
+//-----------------------------------------------------------------
+// thread_snapshot_copy: Copy thread details into snapshot entry
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static void thread_snapshot_copy(struct thread_info *info, struct thread *pThread, uint32_t sleepTime)
+{
+    int l;
+
+    info->thread     = pThread;
+    info->thread_id  = pThread->thread_id;
+    info->priority   = pThread->priority;
+    info->state      = pThread->state;
+    info->current    = (pThread == _current_thread);
+    info->sleep_time = sleepTime;
+    info->run_count  = pThread->run_count;
+
+    for (l=0;l<THREAD_NAME_LEN;l++)
+        info->name[l] = pThread->name[l];
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    info->run_time = pThread->run_time_total;
+
+    // Include time the current thread has been running for
+    if (info->current && pThread->run_start != 0)
+        info->run_time += (uint64_t)cpu_timediff(cpu_timenow(), pThread->run_start);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    info->wake_max = pThread->wake_max;
+    for (l=0;l<THREAD_WAKE_HIST_BUCKETS;l++)
+        info->wake_hist[l] = pThread->wake_hist[l];
+#endif
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    for (l=0;l<CPU_THREAD_PERF_COUNTERS;l++)
+        info->perf[l] = pThread->tcb.perf[l];
+#endif
+}
+//-----------------------------------------------------------------
+// thread_snapshot: Copy state of all threads into 'info'.
+// Interrupts are only disabled whilst the thread details are copied,
+// the stack usage scan and any formatting happen with them enabled.
+// Returns: number of threads copied
+//-----------------------------------------------------------------
+int thread_snapshot(struct thread_info *info, int max_threads)
+{
+    struct thread      *pThread;
+    struct link_node   *node;
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+    uint64_t current_time = cpu_timenow();
+#else
+    uint32_t sleepTimeTotal = 0;
+#endif
+    int count = 0;
+    int i;
+    int cr;
+
+    OS_ASSERT(info != NULL || max_threads == 0);
+
+    cr = critical_start();
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    // Bring the current thread's counters up to date
+    if (_current_thread)
+        cpu_perf_update(&_current_thread->tcb);
+#endif
+
+    // Sleeping threads first (sleep time is cumulative in delta mode)
+    for (node = list_first(&_thread_sleeping); node && count < max_threads; node = list_next(&_thread_sleeping, node))
+    {
+        pThread = list_entry(node, struct thread, node);
+
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+        thread_snapshot_copy(&info[count++], pThread, (uint32_t)(pThread->wakeup_time - current_time));
+#else
+        sleepTimeTotal += pThread->wait_delta;
+        thread_snapshot_copy(&info[count++], pThread, THREAD_SLEEP_LEFT(sleepTimeTotal));
+#endif
+    }
+
+    // Then everything else
+    for (pThread = _thread_list_all; pThread && count < max_threads; pThread = pThread->next_all)
+        if (pThread->state != THREAD_SLEEPING || THREAD_HR_SLEEPING(pThread))
+            thread_snapshot_copy(&info[count++], pThread, 0);
+
+    critical_end(cr);
+
+    // Stack scan can be slow so is done with interrupts enabled
+    // NOTE: Threads must not be killed and their stacks reused whilst
+    // this is in progress.
+    for (i=0;i<count;i++)
+    {
+        info[i].stack_size = cpu_thread_stack_size(&info[i].thread->tcb);
+        info[i].stack_free = cpu_thread_stack_free(&info[i].thread->tcb);
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------
 // thread_print_thread: Print thread details to OS_PRINTF
 //-----------------------------------------------------------------
 static void thread_print_thread(int idx, struct thread *pThread, uint32_t sleepTime, int (*os_printf)(const char* ctrl1, ... ))
 {
-    char stateChar;
+#if defined(CPU_THREAD_PERF_COUNTERS) || defined(CONFIG_RTOS_MEASURE_WAKE_LATENCY)
+    int l;
+#endif
 
     os_printf("%d:\t", idx+1);
     os_printf("|%10.10s|\t", pThread->name);
     os_printf("%d\t", pThread->priority);
-
-    if (pThread == _current_thread)
-        stateChar = '*';
-    else
-    {
-        switch (pThread->state)
-        {
-            case THREAD_RUNABLE:
-                stateChar = 'R';
-            break;
-            case THREAD_SLEEPING:
-                stateChar = 'S';
-            break;
-            case THREAD_BLOCKED:
-                stateChar = 'B';
-            break;
-            case THREAD_DEAD:
-                stateChar = 'X';
-            break;
-            default:
-                stateChar = 'U';
-            break;
-        }
-    }
-
-    os_printf("%c\t", stateChar);
+    os_printf("%c\t", thread_state_char(pThread->state, pThread == _current_thread));
     os_printf("%ld\t", sleepTime);
     os_printf("%ld\t", pThread->run_count);
     os_printf("%ld\r\n", cpu_thread_stack_free(&pThread->tcb));
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    os_printf("\tWake: max %ld hist", pThread->wake_max);
+    for (l=0;l<THREAD_WAKE_HIST_BUCKETS;l++)
+        os_printf(" %d", pThread->wake_hist[l]);
+    os_printf("\r\n");
+#endif
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    os_printf("\tPerf:");
+    for (l=0;l<CPU_THREAD_PERF_COUNTERS;l++)
+        os_printf(" %s %llu", cpu_perf_name(l), (unsigned long long)pThread->tcb.perf[l]);
+    os_printf("\r\n");
+#endif
 }
 //-----------------------------------------------------------------
-// thread_dump_list: Dump thread list via specified printf
+// thread_dump_list: Dump thread list via specified printf.
+// Walks the lists directly with interrupts disabled (no snapshot
+// storage needed, so it is safe from the assert handler).
 //-----------------------------------------------------------------
 void thread_dump_list(int (*os_printf)(const char* ctrl1, ... ))
 {
@@ -874,6 +3139,12 @@ void thread_dump_list(int (*os_printf)(const char* ctrl1, ... ))
 
     int cr = critical_start();
 
+#ifdef CPU_THREAD_PERF_COUNTERS
+    // Bring the current thread's counters up to date
+    if (_current_thread)
+        cpu_perf_update(&_current_thread->tcb);
+#endif
+
     os_printf("Thread Dump:\r\n");
     os_printf("Num     Name        Pri    State    Sleep    Runs    Free Stack\r\n");
 
@@ -896,12 +3167,21 @@ void thread_dump_list(int (*os_printf)(const char* ctrl1, ... ))
         thread_print_thread(idx++, pThread, pThread->wakeup_time - current_time, os_printf);
 #else
         sleepTimeTotal += pThread->wait_delta;
-        thread_print_thread(idx++, pThread, sleepTimeTotal, os_printf);
+        thread_print_thread(idx++, pThread, THREAD_SLEEP_LEFT(sleepTimeTotal), os_printf);
 #endif
 
         node = list_next(&_thread_sleeping, node);
     }
 
+#ifdef CONFIG_RTOS_HRTIMER
+    // Print high resolution sleepers (time left is not in ticks)
+    list_for_each(&_thread_hrsleeping, node)
+    {
+        pThread = list_entry(node, struct thread, node);
+        thread_print_thread(idx++, pThread, 0, os_printf);
+    }
+#endif
+
     // Print blocked threads
     pThread = _thread_list_all;
     while (pThread != NULL)
@@ -923,6 +3203,126 @@ void thread_dump_list(int (*os_printf)(const char* ctrl1, ... ))
     critical_end(cr);
 }
 //-----------------------------------------------------------------
+// thread_snapshot_print: Print a snapshot as a table
+//-----------------------------------------------------------------
+void thread_snapshot_print(const struct thread_info *info, int count, int (*os_printf)(const char* ctrl1, ... ))
+{
+    int i;
+#if defined(CPU_THREAD_PERF_COUNTERS) || defined(CONFIG_RTOS_MEASURE_WAKE_LATENCY)
+    int l;
+#endif
+
+    os_printf("Thread Dump:\r\n");
+    os_printf("Num     Name        Pri    State    Sleep    Runs    Free Stack\r\n");
+
+    for (i=0;i<count;i++)
+    {
+        os_printf("%d:\t", info[i].thread_id);
+        os_printf("|%10.10s|\t", info[i].name);
+        os_printf("%d\t", info[i].priority);
+        os_printf("%c\t", thread_state_char(info[i].state, info[i].current));
+        os_printf("%ld\t", info[i].sleep_time);
+        os_printf("%ld\t", info[i].run_count);
+        os_printf("%ld\r\n", info[i].stack_free);
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+        os_printf("\tWake: max %ld hist", info[i].wake_max);
+        for (l=0;l<THREAD_WAKE_HIST_BUCKETS;l++)
+            os_printf(" %d", info[i].wake_hist[l]);
+        os_printf("\r\n");
+#endif
+    }
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    os_printf("Perf Counters:\r\n");
+    os_printf("Num     Name       ");
+    for (l=0;l<CPU_THREAD_PERF_COUNTERS;l++)
+        os_printf(" %14.14s", cpu_perf_name(l));
+    os_printf("\r\n");
+
+    for (i=0;i<count;i++)
+    {
+        os_printf("%d:\t", info[i].thread_id);
+        os_printf("|%10.10s|", info[i].name);
+        for (l=0;l<CPU_THREAD_PERF_COUNTERS;l++)
+            os_printf(" %14llu", (unsigned long long)info[i].perf[l]);
+        os_printf("\r\n");
+    }
+#endif
+}
+//-----------------------------------------------------------------
+// thread_json_escape: Copy thread name escaping it for a JSON string
+// ('out' must hold THREAD_JSON_NAME_LEN characters)
+//-----------------------------------------------------------------
+#define THREAD_JSON_NAME_LEN    (THREAD_NAME_LEN * 6)
+
+static void thread_json_escape(char *out, const char *name)
+{
+    static const char hex[] = "0123456789abcdef";
+    int l;
+
+    for (l=0;l<THREAD_NAME_LEN && name[l];l++)
+    {
+        char c = name[l];
+
+        if (c == '"' || c == '\\')
+        {
+            *out++ = '\\';
+            *out++ = c;
+        }
+        // Control characters as \u00XX
+        else if ((unsigned char)c < 0x20)
+        {
+            *out++ = '\\';
+            *out++ = 'u';
+            *out++ = '0';
+            *out++ = '0';
+            *out++ = hex[(c >> 4) & 0xF];
+            *out++ = hex[c & 0xF];
+        }
+        else
+            *out++ = c;
+    }
+
+    *out = 0;
+}
+//-----------------------------------------------------------------
+// thread_snapshot_print_json: Print a snapshot as a JSON array
+//-----------------------------------------------------------------
+void thread_snapshot_print_json(const struct thread_info *info, int count, int (*os_printf)(const char* ctrl1, ... ))
+{
+    char name[THREAD_JSON_NAME_LEN + 1];
+    int i;
+#ifdef CPU_THREAD_PERF_COUNTERS
+    int l;
+#endif
+
+    os_printf("[");
+
+    for (i=0;i<count;i++)
+    {
+        thread_json_escape(name, info[i].name);
+
+        os_printf("%s{\"id\":%d,\"name\":\"%s\",\"prio\":%d,\"state\":\"%c\",\"current\":%d,",
+                  i ? "," : "", info[i].thread_id, name, info[i].priority,
+                  thread_state_char(info[i].state, 0), info[i].current);
+        os_printf("\"sleep\":%ld,\"runs\":%ld,\"stack_size\":%d,\"stack_free\":%d",
+                  info[i].sleep_time, info[i].run_count, info[i].stack_size, info[i].stack_free);
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+        os_printf(",\"run_time\":%llu", (unsigned long long)info[i].run_time);
+#endif
+#ifdef CPU_THREAD_PERF_COUNTERS
+        os_printf(",\"perf\":{");
+        for (l=0;l<CPU_THREAD_PERF_COUNTERS;l++)
+            os_printf("%s\"%s\":%llu", l ? "," : "", cpu_perf_name(l), (unsigned long long)info[i].perf[l]);
+        os_printf("}");
+#endif
+        os_printf("}");
+    }
+
+    os_printf("]\r\n");
+}
+//-----------------------------------------------------------------
 // thread_get_cpu_load: Calculate CPU load percentage.
 // Higher = heavier system task load.
 // Requires CONFIG_RTOS_MEASURE_THREAD_TIME to be defined along with 
@@ -937,6 +3337,12 @@ int thread_get_cpu_load(void)
 
     int cr = critical_start();
 
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+    // Interrupt time is not charged to any thread but is load
+    total_time = _irq_run_time;
+    _irq_run_time = 0;
+#endif
+
     // Walk the thread list and calculate sum of total time spent in all threads 
     pThread = _thread_list_all;
     while (pThread != NULL)
@@ -974,6 +3380,231 @@ int thread_get_cpu_load(void)
         return 0;
 }
 #endif
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+//-----------------------------------------------------------------
+// thread_charge_run_time: Add time since thread was scheduled (or
+// last charged) to its run time counters.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_charge_run_time(struct thread *pThread, uint64_t now)
+{
+    int64_t delta;
+
+    // Time=0 has a special meaning (not running)!
+    if (pThread->run_start == 0)
+        return;
+
+    delta = cpu_timediff(now, pThread->run_start);
+    if (delta < 0)
+        delta = 0;
+
+    pThread->run_time       += (uint32_t)delta;
+    pThread->run_time_total += (uint64_t)delta;
+    pThread->run_start       = now ? now : 1;
+}
+//-----------------------------------------------------------------
+// thread_load_update: Fold the next (up to) THREAD_LOAD_UPDATE_MAX
+// threads' run time since they were last folded into their load
+// moving averages. Each thread's sample covers its own interval, so
+// the walk may span several ticks (and windows) without skewing it.
+// NOTE: Must be called within critical protection region (or INT)
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_load_update(void)
+{
+    struct thread *pThread;
+    uint64_t now = cpu_timenow();
+    int count;
+    int i;
+
+    // Bring the running thread's time up to date
+    thread_charge_run_time(_current_thread, now);
+
+    for (count = 0; _load_update_next != NULL && count < THREAD_LOAD_UPDATE_MAX; count++)
+    {
+        uint64_t used;
+        uint64_t window;
+        int32_t sample;
+
+        pThread = _load_update_next;
+        _load_update_next = pThread->next_all;
+
+        used = pThread->run_time_total - pThread->run_time_window;
+        window = (uint64_t)cpu_timediff(now, pThread->load_time);
+
+        // First fold has no start time, just sync the counters
+        if (pThread->load_time == 0)
+            window = 0;
+
+        pThread->run_time_window = pThread->run_time_total;
+        pThread->load_time = now ? now : 1;
+
+        if (window == 0)
+            continue;
+
+        // Fraction of the interval spent in this thread (1.0 = 65536)
+        if (used >= window)
+            sample = 65536;
+        else
+            sample = (int32_t)((used << 16) / window);
+
+        for (i=0;i<THREAD_LOAD_AVG_COUNT;i++)
+        {
+            int32_t avg = (int32_t)pThread->load_avg[i];
+
+            avg += (sample - avg) >> _load_avg_shift[i];
+            pThread->load_avg[i] = (uint32_t)avg;
+        }
+    }
+}
+//-----------------------------------------------------------------
+// thread_get_load: Snapshot per-thread cumulative run time and load
+// averages. Does not clear any counters so may be used by many
+// monitors at once.
+// Returns: number of threads copied
+//-----------------------------------------------------------------
+int thread_get_load(struct thread_load *load, int max_threads)
+{
+    struct thread *pThread;
+    int count = 0;
+    int i;
+
+    int cr = critical_start();
+
+    for (pThread = _thread_list_all; pThread != NULL && count < max_threads; pThread = pThread->next_all)
+    {
+        load[count].thread    = pThread;
+        load[count].thread_id = pThread->thread_id;
+        load[count].run_time  = pThread->run_time_total;
+
+        // Include time the current thread has been running for
+        if (pThread == _current_thread && pThread->run_start != 0)
+            load[count].run_time += (uint64_t)cpu_timediff(cpu_timenow(), pThread->run_start);
+
+        for (i=0;i<THREAD_LOAD_AVG_COUNT;i++)
+            load[count].load[i] = (uint16_t)((pThread->load_avg[i] * 1000) >> 16);
+
+        count++;
+    }
+
+    critical_end(cr);
+
+    return count;
+}
+//-----------------------------------------------------------------
+// thread_get_system_load: System load average (per-mille)
+//-----------------------------------------------------------------
+int thread_get_system_load(int avg_idx)
+{
+    OS_ASSERT(avg_idx >= 0 && avg_idx < THREAD_LOAD_AVG_COUNT);
+
+    // Anything not spent in the idle task is load
+    return 1000 - (int)((_idle_task.load_avg[avg_idx] * 1000) >> 16);
+}
+#endif
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+//-----------------------------------------------------------------
+// thread_irq_enter: Start of interrupt handler.
+// Stops the interrupted thread's run time so that interrupt time
+// is not charged to whichever thread happened to be running.
+// NOTE: Interrupt context only (nesting not supported)
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_irq_enter(int source)
+{
+    _irq_start  = cpu_timenow();
+    _irq_source = source;
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    if (_current_thread)
+    {
+        thread_charge_run_time(_current_thread, _irq_start);
+
+        // Paused until thread_irq_exit
+        _current_thread->run_start = 0;
+    }
+#endif
+}
+//-----------------------------------------------------------------
+// thread_irq_source: Re-attribute the current interrupt
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_irq_source(int source)
+{
+    _irq_source = source;
+}
+//-----------------------------------------------------------------
+// thread_irq_exit: End of interrupt handler.
+// Resumes run time of the (possibly new) current thread.
+// NOTE: Interrupt context only (nesting not supported)
+//-----------------------------------------------------------------
+CRITICALFUNC void thread_irq_exit(void)
+{
+    struct thread_irq_stats *stats;
+    uint64_t now = cpu_timenow();
+    int64_t delta = cpu_timediff(now, _irq_start);
+    uint32_t duration;
+
+    if (delta < 0)
+        delta = 0;
+    else if (delta > 0xFFFFFFFF)
+        delta = 0xFFFFFFFF;
+    duration = (uint32_t)delta;
+
+    if (_irq_source >= 0 && _irq_source < THREAD_IRQ_SOURCES)
+    {
+        stats = &_irq_stats[_irq_source];
+        stats->count++;
+        stats->total += duration;
+        if (duration > stats->max)
+            stats->max = duration;
+    }
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    _irq_run_time += duration;
+
+    // Thread to be resumed starts accumulating run time from now
+    if (_current_thread)
+        _current_thread->run_start = now ? now : 1;
+#endif
+}
+//-----------------------------------------------------------------
+// thread_get_irq_stats: Get time accounting for an interrupt source
+//-----------------------------------------------------------------
+int thread_get_irq_stats(int source, struct thread_irq_stats *stats)
+{
+    int cr;
+
+    if (source < 0 || source >= THREAD_IRQ_SOURCES || !stats)
+        return 0;
+
+    cr = critical_start();
+    *stats = _irq_stats[source];
+    critical_end(cr);
+
+    return 1;
+}
+//-----------------------------------------------------------------
+// thread_dump_irq_stats: Dump interrupt time accounting
+//-----------------------------------------------------------------
+void thread_dump_irq_stats(int (*os_printf)(const char* ctrl1, ... ))
+{
+    struct thread_irq_stats stats;
+    int i;
+
+    os_printf("IRQ Stats:\r\n");
+    os_printf("Src     Count    Avg    Max\r\n");
+
+    for (i=0;i<THREAD_IRQ_SOURCES;i++)
+    {
+        thread_get_irq_stats(i, &stats);
+        if (!stats.count)
+            continue;
+
+        os_printf("%d:\t", i);
+        os_printf("%ld\t", stats.count);
+        os_printf("%ld\t", (uint32_t)(stats.total / stats.count));
+        os_printf("%ld\r\n", stats.max);
+    }
+}
+#endif
 //-----------------------------------------------------------------
 // thread_get_first_thread:
 //-----------------------------------------------------------------
@@ -981,3 +3612,67 @@ struct thread *thread_get_first_thread(void)
 {
     return _thread_list_all;
 }
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+//-----------------------------------------------------------------
+// thread_wake_record: Record time from becoming run-able to being
+// picked into the thread's log2 latency histogram.
+// NOTE: Must be called within critical protection region
+//-----------------------------------------------------------------
+static CRITICALFUNC void thread_wake_record(struct thread *pThread)
+{
+    int64_t  delta = cpu_timediff(cpu_timenow(), pThread->ready_time);
+    uint32_t latency;
+    int bucket = 0;
+
+    pThread->ready_time = 0;
+
+    if (delta < 0)
+        delta = 0;
+    else if (delta > 0xFFFFFFFF)
+        delta = 0xFFFFFFFF;
+
+    latency = (uint32_t)delta;
+
+    // Worst case seen
+    if (latency > pThread->wake_max)
+        pThread->wake_max = latency;
+
+    // Bucket N holds latencies below 2^(N+1) (and >= 2^N for N > 0)
+    latency >>= THREAD_WAKE_HIST_SHIFT;
+    while (latency > 1 && bucket < (THREAD_WAKE_HIST_BUCKETS - 1))
+    {
+        latency >>= 1;
+        bucket++;
+    }
+
+    // Saturate rather than wrap
+    if (pThread->wake_hist[bucket] != 0xFFFF)
+        pThread->wake_hist[bucket]++;
+}
+//-----------------------------------------------------------------
+// thread_get_wake_latency: Get wake-to-run latency histogram.
+// Returns: number of buckets copied into 'hist'
+//-----------------------------------------------------------------
+int thread_get_wake_latency(struct thread *pThread, uint32_t *hist, int buckets, uint32_t *max)
+{
+    int i;
+    int cr;
+
+    OS_ASSERT(pThread != NULL);
+
+    if (buckets > THREAD_WAKE_HIST_BUCKETS)
+        buckets = THREAD_WAKE_HIST_BUCKETS;
+
+    cr = critical_start();
+
+    for (i=0;hist && i<buckets;i++)
+        hist[i] = pThread->wake_hist[i];
+
+    if (max)
+        *max = pThread->wake_max;
+
+    critical_end(cr);
+
+    return hist ? buckets : 0;
+}
+#endif
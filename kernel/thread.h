@@ -64,6 +64,110 @@
 // Thread sleep arg used to yield
 #define THREAD_YIELD        0
 
+// Default round-robin time slice (ticks)
+#ifndef THREAD_DEFAULT_QUANTUM
+    #define THREAD_DEFAULT_QUANTUM      1
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+// Priority level of the earliest deadline first class. EDF threads
+// preempt fixed priority threads at or below this level and are
+// preempted by those above it.
+#ifndef THREAD_EDF_PRIO
+    #define THREAD_EDF_PRIO             (THREAD_MAX_PRIO / 2)
+#endif
+
+// Max number of EDF threads
+#ifndef THREAD_EDF_MAX
+    #define THREAD_EDF_MAX              16
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+// Max expired sleepers made run-able by one tick interrupt, the rest
+// are woken by a deferred pass at THREAD_INT_PRIO
+#ifndef THREAD_TICK_WAKE_MAX
+    #define THREAD_TICK_WAKE_MAX        4
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+// Kernel requests queued from interrupt context (power of 2, must hold
+// every request made while a thread holds the kernel lock)
+#ifndef THREAD_ISR_QUEUE_ENTRIES
+    #define THREAD_ISR_QUEUE_ENTRIES    32
+#endif
+
+// Kernel object protection: interrupts stay enabled, the tick and ISR
+// requests are held off until the outermost KERNEL_UNLOCK
+#define KERNEL_LOCK()                   thread_kernel_lock()
+#define KERNEL_UNLOCK(cr)               thread_kernel_unlock(cr)
+#else
+#define KERNEL_LOCK()                   critical_start()
+#define KERNEL_UNLOCK(cr)               critical_end(cr)
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+// Number of log2 buckets in the wake-to-run latency histogram
+#ifndef THREAD_WAKE_HIST_BUCKETS
+    #define THREAD_WAKE_HIST_BUCKETS    16
+#endif
+
+// Latency (cpu_timenow units) is shifted right by this before bucketing.
+// Ports set CPU_WAKE_HIST_SHIFT so bucket 0 ends at about 1us.
+#ifndef THREAD_WAKE_HIST_SHIFT
+    #ifdef CPU_WAKE_HIST_SHIFT
+        #define THREAD_WAKE_HIST_SHIFT  CPU_WAKE_HIST_SHIFT
+    #else
+        #define THREAD_WAKE_HIST_SHIFT  0
+    #endif
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+// Load average sample window (ticks)
+#ifndef THREAD_LOAD_WINDOW
+    #define THREAD_LOAD_WINDOW          100
+#endif
+
+// Load moving averages, each sample weighted by 1/2^shift
+// (shift 0 = load over the last window only, one shift per average)
+#ifndef THREAD_LOAD_AVG_COUNT
+    #define THREAD_LOAD_AVG_COUNT       3
+#endif
+
+#ifndef THREAD_LOAD_AVG_SHIFTS
+    #define THREAD_LOAD_AVG_SHIFTS      {0, 3, 5}
+#endif
+
+// Threads folded into the load averages per tick at the end of each
+// window (bounds the work done in the tick interrupt)
+#ifndef THREAD_LOAD_UPDATE_MAX
+    #define THREAD_LOAD_UPDATE_MAX      4
+#endif
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+// Number of interrupt sources with time accounting
+#ifndef THREAD_IRQ_SOURCES
+    #define THREAD_IRQ_SOURCES          8
+#endif
+
+// Interrupt sources used by the ports (platforms may use the rest).
+// External interrupts are charged to THREAD_IRQ_EXT unless the source
+// is named: on riscv by overriding cpu_irq_source(), otherwise by the
+// platform handler calling thread_irq_source().
+#define THREAD_IRQ_TICK                 0
+#define THREAD_IRQ_EXT                  1
+#endif
+
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+// Per-thread shadow call stack depth (deeper calls are not profiled)
+#ifndef THREAD_FUNC_PROFILE_DEPTH
+    #define THREAD_FUNC_PROFILE_DEPTH   32
+#endif
+#endif
+
 //-----------------------------------------------------------------
 // Enums
 //-----------------------------------------------------------------
@@ -77,9 +181,119 @@ typedef enum eThreadState
     THREAD_DEAD
 } tThreadState;
 
+// Scheduling policy (between threads of equal priority)
+typedef enum eThreadPolicy
+{
+    // Time sliced, move behind equal priority threads every 'quantum' ticks
+    THREAD_SCHED_RR,
+    // Run until blocked, sleeping or yielding
+    THREAD_SCHED_FIFO,
+#ifdef CONFIG_RTOS_EDF
+    // Earliest deadline first (priority level THREAD_EDF_PRIO)
+    THREAD_SCHED_EDF,
+#endif
+} tThreadPolicy;
+
 //-----------------------------------------------------------------
 // Types
 //-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+// Function profiler shadow call stack frame (see func_profile.c)
+struct func_profile_frame
+{
+    void           *func;
+
+    // Thread virtual time at entry and time spent in callees
+    uint64_t        enter;
+    uint64_t        child;
+};
+#endif
+
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+// Periodic thread release statistics (ticks)
+struct thread_period_stats
+{
+    // Jobs released
+    uint32_t        releases;
+
+    // Release points which passed before the previous job completed
+    uint32_t        overruns;
+
+    // Release jitter (start of job - release time)
+    uint32_t        jitter_last;
+    uint32_t        jitter_max;
+    uint32_t        jitter_total;
+};
+#endif
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+// ISR request queue statistics
+struct thread_isr_queue_stats
+{
+    // Requests queued from interrupt context
+    uint32_t        requests;
+
+    // Requests which found the queue full (applied in the ISR once the
+    // queue was drained)
+    uint32_t        overflows;
+
+    // Max requests waiting at once
+    uint32_t        depth_max;
+
+    // Ticks held off until the kernel lock was released
+    uint32_t        ticks_deferred;
+};
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+// CPU budget reservation shared by one or more threads. When the budget
+// for the current period is used up the threads are demoted to
+// demote_prio until the next replenishment.
+struct thread_reservation
+{
+    // Budget per period (cpu_timenow units), period (ticks)
+    uint64_t        budget;
+    uint32_t        period;
+    int             demote_prio;
+
+    // Budget left, tick of next replenishment, budget used up
+    uint64_t        remaining;
+    uint32_t        next_replenish;
+    int             exhausted;
+
+    // Number of periods the budget was used up in
+    uint32_t        exhaustions;
+
+    struct thread_reservation *next;
+};
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+// Cyclic executive slot: thread run exclusively for 'ticks' ticks
+// (thread NULL = priority scheduled threads only)
+struct thread_cyclic_slot
+{
+    struct thread  *thread;
+    uint32_t        ticks;
+};
+
+// Minor frame: sequence of slots. A table of minor frames is one major
+// frame, which repeats.
+struct thread_cyclic_frame
+{
+    const struct thread_cyclic_slot *slots;
+    int             num_slots;
+};
+
+// Per slot statistics (kept apart from the table so it can be const)
+struct thread_cyclic_stats
+{
+    // Times released and times the job was not complete by the end
+    uint32_t        releases;
+    uint32_t        overruns;
+};
+#endif
+
 struct thread
 {
     // CPU specific thread state
@@ -91,8 +305,30 @@ struct thread
     // Thread name (used in debug output)
     char            name[THREAD_NAME_LEN];
 
-    // Thread priority
+    // Thread priority (effective, used for scheduling) and priority
+    // requested by thread_init / thread_set_priority
     int             priority;
+    int             base_priority;
+
+    // Scheduling policy, time slice and ticks left of it (RR only)
+    tThreadPolicy   policy;
+    uint32_t        quantum;
+    uint32_t        quantum_left;
+
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+    // Only threads above this priority may preempt this thread while it
+    // is running (<= priority = disabled)
+    int             preempt_threshold;
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+    // Absolute deadline (ticks), position in the EDF ready heap (-1 = not
+    // in it), number of deadlines missed and current deadline missed flag
+    uint32_t        deadline;
+    int             edf_index;
+    uint32_t        deadline_misses;
+    int             deadline_missed;
+#endif
 
     // state (Run-able, blocked or sleeping)
     tThreadState    state;
@@ -103,15 +339,79 @@ struct thread
 #else
     // Sleep time remaining (ticks) (delta)
     uint32_t        wait_delta;
+
+    // Periodic release (ticks, period 0 = not periodic) and statistics
+    uint32_t        period;
+    uint32_t        next_release;
+    struct thread_period_stats period_stats;
+#endif
+
+#ifdef CONFIG_RTOS_HRTIMER
+    // On the high resolution sleep list, wake time (cpu_timenow units)
+    int             hr_sleeping;
+    uint64_t        hr_wakeup;
 #endif
 
     // Thread run count
     uint32_t        run_count;
 
+    // Scheduler lock nesting count (preemption deferred while non-zero)
+    int             sched_lock;
+
+#ifdef CONFIG_RTOS_ISR_DEFER
+    // Kernel lock nesting count (tick and ISR requests deferred while non-zero)
+    volatile int    kernel_lock;
+#endif
+
 #ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
     // Measure time each thread is active for?
     uint32_t        run_time;
-    uint32_t        run_start;
+    uint64_t        run_start;
+
+    // Cumulative run time (never cleared), total and time (0 = never)
+    // when last folded into the load averages
+    uint64_t        run_time_total;
+    uint64_t        run_time_window;
+    uint64_t        load_time;
+
+    // Load moving averages (fraction of CPU, 1.0 = 65536)
+    uint32_t        load_avg[THREAD_LOAD_AVG_COUNT];
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    // Cyclic executive job state (see thread.c)
+    int             cyclic_state;
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    // CPU budget this thread is charged to (NULL = unlimited)
+    struct thread_reservation *reservation;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    // Time thread last became run-able (0 = not waiting to run)
+    uint64_t        ready_time;
+
+    // Wake-to-run latency: worst case and log2 histogram (saturating)
+    uint32_t        wake_max;
+    uint16_t        wake_hist[THREAD_WAKE_HIST_BUCKETS];
+#endif
+
+#ifdef CONFIG_RTOS_API_STATS
+    // Total time spent switched out (blocked, sleeping or preempted)
+    // and when the thread was last switched out (0 = running)
+    uint64_t        api_switched;
+    uint64_t        api_switch_out;
+#endif
+
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+    // Shadow call stack (depth may exceed THREAD_FUNC_PROFILE_DEPTH)
+    struct func_profile_frame prof_stack[THREAD_FUNC_PROFILE_DEPTH];
+    int             prof_depth;
+
+    // Total time switched out and when last switched out (0 = running)
+    uint64_t        prof_switched;
+    uint64_t        prof_switch_out;
 #endif
 
     // Thread function
@@ -136,6 +436,68 @@ struct thread
     uint32_t        checkword;
 };
 
+// Thread snapshot (see thread_snapshot)
+struct thread_info
+{
+    struct thread  *thread;
+    int             thread_id;
+    char            name[THREAD_NAME_LEN];
+    int             priority;
+    tThreadState    state;
+
+    // Was this the running thread
+    int             current;
+
+    // Sleep time remaining (0 if not sleeping)
+    uint32_t        sleep_time;
+    uint32_t        run_count;
+
+    // Stack size and free (never used) entries
+    int             stack_size;
+    int             stack_free;
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    // Cumulative run time (cpu_timenow units)
+    uint64_t        run_time;
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    // Wake-to-run latency worst case and log2 histogram
+    uint32_t        wake_max;
+    uint16_t        wake_hist[THREAD_WAKE_HIST_BUCKETS];
+#endif
+
+#ifdef CPU_THREAD_PERF_COUNTERS
+    // Port performance counter totals (see cpu_perf_name)
+    uint64_t        perf[CPU_THREAD_PERF_COUNTERS];
+#endif
+};
+
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+// Thread load snapshot
+struct thread_load
+{
+    struct thread  *thread;
+    int             thread_id;
+
+    // Cumulative run time (cpu_timenow units)
+    uint64_t        run_time;
+
+    // Load moving averages (per-mille of CPU)
+    uint16_t        load[THREAD_LOAD_AVG_COUNT];
+};
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+// Per interrupt source time accounting
+struct thread_irq_stats
+{
+    uint32_t        count;
+    uint32_t        max;
+    uint64_t        total;
+};
+#endif
+
 //-----------------------------------------------------------------
 // Macros
 //-----------------------------------------------------------------
@@ -162,6 +524,45 @@ int             thread_init(struct thread *pThread, const char *name, int pri, v
 // Init thread with specified start state
 int             thread_init_ex(struct thread *pThread, const char *name, int pri, void *(*f)(void *), void *arg, void *stack, uint32_t stack_size, tThreadState initial_state);
 
+// Change thread priority (reschedules immediately if required)
+int             thread_set_priority(struct thread *pThread, int pri);
+
+// Set scheduling policy & round-robin time slice in ticks (0 = default)
+int             thread_set_policy(struct thread *pThread, tThreadPolicy policy, uint32_t quantum);
+
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+// Set preemption threshold (<= thread priority = disabled)
+int             thread_set_preempt_threshold(struct thread *pThread, int threshold);
+#endif
+
+#ifdef CONFIG_RTOS_EDF
+// Set absolute deadline (tick count) of an EDF thread (reschedules immediately if required)
+void            thread_set_deadline(struct thread *pThread, uint32_t deadline);
+
+// Total number of EDF deadlines missed
+uint32_t        thread_edf_misses(void);
+#endif
+
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+// Init CPU budget reservation (budget in cpu_timenow units per period in ticks)
+void            thread_reservation_init(struct thread_reservation *res, uint64_t budget, uint32_t period, int demote_prio);
+
+// Charge thread to a reservation (NULL = unlimited, reschedules immediately if required)
+void            thread_reservation_attach(struct thread *pThread, struct thread_reservation *res);
+#endif
+
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+// Start dispatching threads from a static cyclic executive table.
+// 'stats' (optional) has one entry per slot, in table order.
+void            thread_cyclic_init(const struct thread_cyclic_frame *table, int num_frames, struct thread_cyclic_stats *stats);
+
+// Complete the current job and wait for the thread's next slot
+void            thread_cyclic_wait(void);
+
+// Dump per slot release / overrun counts
+void            thread_cyclic_dump(int (*os_printf)(const char* ctrl1, ... ));
+#endif
+
 // Kill thread and remove from all thread lists.
 // Once complete, thread data/stack will not be accessed again by RTOS.
 // You cannot kill a thread from itself, use thread_suicide instead.
@@ -176,19 +577,62 @@ void*           thread_join(struct thread *pThread);
 // Sleep thread for x time units
 void            thread_sleep(uint32_t time_units);
 
+// Sleep thread for x time units, waking up to 'slack' units later to
+// share the wakeup of another sleeping thread
+void            thread_sleep_slack(uint32_t time_units, uint32_t slack);
+
+// Number of sleeps which shared the wakeup of another thread
+uint32_t        thread_sleep_coalesced(void);
+
 // Extended thread sleep API
 void            thread_sleep_thread(struct thread *pSleepThread, uint32_t time_units);
+void            thread_sleep_thread_slack(struct thread *pSleepThread, uint32_t time_units, uint32_t slack);
 void            thread_sleep_cancel(struct thread *pThread);
 
+#ifndef CONFIG_RTOS_ABSOLUTE_TIME
+// Sleep until the tick count reaches wake_tick (returns 0 if already passed)
+int             thread_sleep_until(uint32_t wake_tick);
+
+// Make thread periodic, first job released at first_release (period 0 = not periodic)
+void            thread_set_period(struct thread *pThread, uint32_t period, uint32_t first_release);
+
+// Wait for the next periodic release (returns number of release points missed)
+uint32_t        thread_wait_next_period(void);
+
+// Get periodic release statistics
+void            thread_get_period_stats(struct thread *pThread, struct thread_period_stats *stats);
+#endif
+
+#ifdef CONFIG_RTOS_HRTIMER
+// Sleep for a (sub-tick) duration in cpu_timenow() units, woken by the
+// port's one-shot timer (cpu_hrtimer_set) rather than the tick
+void            thread_sleep_hr(uint64_t duration);
+
+// Sleep until cpu_timenow() reaches wake_time (returns 0 if already passed)
+int             thread_sleep_hr_until(uint64_t wake_time);
+
+// One-shot timer handler, called by the port before thread_load_context
+void            thread_hrtimer_irq(void);
+#endif
+
 // Get current thread
 struct thread*  thread_current(void);
 
+// Defer preemption of the current thread (nestable, interrupts stay enabled)
+void            thread_sched_lock(void);
+void            thread_sched_unlock(void);
+
 // Kernel tick handler
 void            thread_tick(void);
 
 // Get the tick count for the RTOS
 uint32_t        thread_tick_count(void);
 
+#ifdef CONFIG_RTOS_TICK_WAKE_BATCH
+// Number of ticks which spilled wakeups into the deferred pass
+uint32_t        thread_tick_wake_spills(void);
+#endif
+
 // Block specified thread
 void            thread_block(struct thread *pThread);
 
@@ -198,17 +642,74 @@ void            thread_unblock(struct thread *pThread);
 // Unblock thread from running (called from ISR context)
 void            thread_unblock_irq(struct thread *pThread);
 
-// Dump thread list via specified printf
+#ifdef CONFIG_RTOS_ISR_DEFER
+// Kernel request from interrupt context, run with interrupts masked on
+// interrupt exit or, if the interrupted thread holds the kernel lock,
+// when it releases it.
+// Returns: 1 if the kernel should run on interrupt exit (see cpu_context_switch_irq)
+int             thread_isr_defer(void (*func)(void *arg), void *arg);
+
+// Protect kernel lists / objects without masking interrupts (nestable).
+// Returns: value to pass to thread_kernel_unlock
+int             thread_kernel_lock(void);
+
+// Release the kernel lock, applying anything held off and switching to
+// a higher priority thread it made run-able
+void            thread_kernel_unlock(int cr);
+
+// Get ISR request queue statistics
+void            thread_isr_defer_stats(struct thread_isr_queue_stats *stats);
+#endif
+
+// Dump thread list via specified printf (with interrupts disabled,
+// see thread_snapshot for a dump which leaves them enabled)
 void            thread_dump_list(int (*os_printf)(const char* ctrl1, ... ));
 
-// Calculate CPU load percentage
+// Copy state of all threads (interrupts only disabled during the copy).
+// Returns: number of threads copied
+int             thread_snapshot(struct thread_info *info, int max_threads);
+
+// Print a snapshot as a table / as JSON (interrupts enabled)
+void            thread_snapshot_print(const struct thread_info *info, int count, int (*os_printf)(const char* ctrl1, ... ));
+void            thread_snapshot_print_json(const struct thread_info *info, int count, int (*os_printf)(const char* ctrl1, ... ));
+
+// Calculate CPU load percentage (clears per-thread run_time)
 int             thread_get_cpu_load(void);
 
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+// Snapshot per-thread cumulative run time & load averages (non-destructive)
+int             thread_get_load(struct thread_load *load, int max_threads);
+
+// System load average (per-mille, excludes idle task)
+int             thread_get_system_load(int avg_idx);
+#endif
+
+#ifdef CONFIG_RTOS_MEASURE_IRQ_TIME
+// Interrupt entry / exit (called by the port's interrupt handlers)
+void            thread_irq_enter(int source);
+void            thread_irq_exit(void);
+
+// Re-attribute the current interrupt to a specific source
+// (called by a platform interrupt handler once it has decoded the source)
+void            thread_irq_source(int source);
+
+// Get time accounting for an interrupt source (returns 1 if valid)
+int             thread_get_irq_stats(int source, struct thread_irq_stats *stats);
+
+// Dump interrupt time accounting via specified printf
+void            thread_dump_irq_stats(int (*os_printf)(const char* ctrl1, ... ));
+#endif
+
 // Find highest priority run-able thread to run
 void            thread_load_context(int preempt);
 
 // Get list of all system threads
 struct thread * thread_get_first_thread(void);
 
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+// Get wake-to-run latency histogram (returns number of buckets copied)
+int             thread_get_wake_latency(struct thread *pThread, uint32_t *hist, int buckets, uint32_t *max);
+#endif
+
 #endif
 
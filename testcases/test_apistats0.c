@@ -0,0 +1,76 @@
+#include "test.h"
+#include "kernel/api_stats.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define SLEEP_TICKS     5
+
+// Well below the time spent switched out (cpu_timenow units)
+#define API_LIMIT       1000000
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_API_STATS
+THREAD_DECL(spinner, 1024);
+
+static struct semaphore _sema;
+static volatile int     _spin;
+
+//-----------------------------------------------------------------
+// spinner_func: Same priority as the test thread, round-robins with it
+//-----------------------------------------------------------------
+static void* spinner_func(void *arg)
+{
+    while (_spin)
+        ;
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_API_STATS
+    struct api_stats stats;
+    uint64_t start;
+    int i;
+
+    semaphore_init(&_sema, 0);
+    api_stats_reset();
+
+    // Sleeping / blocked time is not charged to the call
+    start = cpu_timenow();
+    thread_sleep(SLEEP_TICKS);
+    OS_ASSERT(!semaphore_timed_pend(&_sema, SLEEP_TICKS));
+    OS_ASSERT(cpu_timediff(cpu_timenow(), start) > API_LIMIT);
+
+    OS_ASSERT(api_stats_get(API_STATS_THREAD_SLEEP, &stats));
+    OS_ASSERT(stats.count == 1);
+    OS_ASSERT(stats.max < API_LIMIT);
+
+    OS_ASSERT(api_stats_get(API_STATS_SEMAPHORE_TIMED_PEND, &stats));
+    OS_ASSERT(stats.count == 1);
+    OS_ASSERT(stats.max < API_LIMIT);
+
+    // Preempted by the tick (round-robin with a busy thread) while
+    // inside calls: still only the kernel's own execution time
+    _spin = 1;
+    THREAD_INIT(spinner, "spinner", spinner_func, NULL, thread_current()->priority);
+    start = cpu_timenow();
+    for (i=0;cpu_timediff(cpu_timenow(), start) < API_LIMIT * 20;i++)
+        OS_ASSERT(!semaphore_try(&_sema));
+    _spin = 0;
+    thread_sleep(1);
+
+    OS_ASSERT(api_stats_get(API_STATS_SEMAPHORE_TRY, &stats));
+    OS_ASSERT(stats.count == (uint32_t)i);
+    OS_ASSERT(stats.max < API_LIMIT);
+
+    api_stats_dump_csv(printf);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,114 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define JOBS            8
+#define OVERRUN_TICKS   10
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+THREAD_DECL(thread_a, 1024);
+THREAD_DECL(thread_b, 1024);
+
+static uint32_t          _a_start[JOBS];
+static volatile int      _a_jobs;
+static volatile int      _b_jobs;
+
+// Major frame of 10 ticks: A every 5 ticks, B once
+static const struct thread_cyclic_slot _frame0[] =
+{
+    { .thread = &thread_thread_a, .ticks = 2 },
+    { .thread = &thread_thread_b, .ticks = 3 },
+};
+
+static const struct thread_cyclic_slot _frame1[] =
+{
+    { .thread = &thread_thread_a, .ticks = 2 },
+    { .thread = NULL,             .ticks = 3 },
+};
+
+static const struct thread_cyclic_frame _table[] =
+{
+    { .slots = _frame0, .num_slots = 2 },
+    { .slots = _frame1, .num_slots = 2 },
+};
+
+// One entry per slot in table order: A, B, A, (none)
+static struct thread_cyclic_stats _stats[4];
+
+//-----------------------------------------------------------------
+// a_func: Short job, record release tick
+//-----------------------------------------------------------------
+static void* a_func(void *arg)
+{
+    while (1)
+    {
+        if (_a_jobs < JOBS)
+            _a_start[_a_jobs] = thread_tick_count();
+        _a_jobs++;
+        thread_cyclic_wait();
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// b_func: Second job overruns its slot
+//-----------------------------------------------------------------
+static void* b_func(void *arg)
+{
+    uint32_t end;
+
+    while (1)
+    {
+        if (++_b_jobs == 2)
+        {
+            end = thread_tick_count() + OVERRUN_TICKS;
+            while ((int32_t)(thread_tick_count() - end) < 0)
+                ;
+        }
+        thread_cyclic_wait();
+    }
+
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_CYCLIC_EXECUTIVE
+    int i;
+
+    THREAD_INIT(thread_a, "A", a_func, NULL, 1);
+    THREAD_INIT(thread_b, "B", b_func, NULL, 1);
+
+    thread_cyclic_init(_table, 2, _stats);
+
+    // Priority scheduled threads still run in the free time
+    while (_a_jobs < JOBS)
+        thread_sleep(1);
+
+    thread_cyclic_dump(printf);
+
+    // Zero jitter releases
+    for (i=1;i<JOBS;i++)
+        OS_ASSERT(_a_start[i] - _a_start[i-1] == 5);
+
+    // A never overran, B overran once
+    OS_ASSERT(_stats[0].overruns == 0);
+    OS_ASSERT(_stats[2].overruns == 0);
+    OS_ASSERT(_stats[1].overruns == 1);
+    OS_ASSERT(_b_jobs >= 2);
+
+    // Released every major frame, empty slot never counted
+    OS_ASSERT(_stats[0].releases >= JOBS / 2);
+    OS_ASSERT(_stats[2].releases >= JOBS / 2 - 1);
+    OS_ASSERT(_stats[3].releases == 0);
+#endif
+
+    exit(0);
+}
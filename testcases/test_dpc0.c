@@ -0,0 +1,64 @@
+#include "test.h"
+#include "kernel/dpc.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static int          _order[DPC_ENTRIES + 1];
+static volatile int _runs;
+
+//-----------------------------------------------------------------
+// dpc_func: Record the order calls run in
+//-----------------------------------------------------------------
+static void dpc_func(void *arg)
+{
+    // Runs at THREAD_INT_PRIO, ahead of every normal thread
+    OS_ASSERT(thread_current()->priority == THREAD_INT_PRIO);
+
+    _order[_runs++] = (int)(long)arg;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct dpc_stats stats;
+    int i;
+
+    dpc_init();
+
+    // Runs before dpc_queue returns
+    OS_ASSERT(dpc_queue(dpc_func, (void*)1));
+    OS_ASSERT(_runs == 1);
+
+    // Queued while the scheduler is locked: one batched pass in order
+    thread_sched_lock();
+    OS_ASSERT(dpc_queue(dpc_func, (void*)2));
+    OS_ASSERT(dpc_queue(dpc_func, (void*)3));
+    OS_ASSERT(dpc_queue(dpc_func, (void*)4));
+    OS_ASSERT(_runs == 1);
+    thread_sched_unlock();
+
+    OS_ASSERT(_runs == 4);
+    for (i=0;i<4;i++)
+        OS_ASSERT(_order[i] == i + 1);
+
+    // Full queue drops and counts
+    _runs = 0;
+    thread_sched_lock();
+    for (i=0;i<DPC_ENTRIES;i++)
+        OS_ASSERT(dpc_queue(dpc_func, (void*)(long)i));
+    OS_ASSERT(!dpc_queue(dpc_func, NULL));
+    thread_sched_unlock();
+    OS_ASSERT(_runs == DPC_ENTRIES);
+
+    dpc_get_stats(&stats);
+    printf("queued=%d executed=%d overflows=%d depth_max=%d latency_max=%d\n",
+           stats.queued, stats.executed, stats.overflows, stats.depth_max, stats.latency_max);
+    OS_ASSERT(stats.queued == DPC_ENTRIES + 4);
+    OS_ASSERT(stats.executed == DPC_ENTRIES + 4);
+    OS_ASSERT(stats.overflows == 1);
+    OS_ASSERT(stats.depth_max == DPC_ENTRIES);
+
+    exit(0);
+}
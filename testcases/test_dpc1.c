@@ -0,0 +1,109 @@
+#include "test.h"
+#include "kernel/dpc.h"
+#include "kernel/os_timer.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define BATCH           4
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef INCLUDE_OS_TIMER
+static struct os_timer  _timer;
+static int              _order[DPC_ENTRIES + 1];
+static volatile int     _runs;
+
+// Set while the timer callback (tick interrupt) is running
+static volatile int     _in_isr;
+static volatile int     _isr_calls;
+static volatile int     _isr_queued;
+static volatile int     _isr_runs;
+static volatile uint32_t _isr_tick;
+static volatile uint32_t _run_tick;
+
+//-----------------------------------------------------------------
+// dpc_func: Record the order calls run in
+//-----------------------------------------------------------------
+static void dpc_func(void *arg)
+{
+    // Not from the interrupt, but the DPC thread ahead of everything else
+    OS_ASSERT(!_in_isr);
+    OS_ASSERT(thread_current()->priority == THREAD_INT_PRIO);
+
+    _order[_runs++] = (int)(long)arg;
+    _run_tick = thread_tick_count();
+}
+//-----------------------------------------------------------------
+// timer_func: Queue calls from the tick interrupt
+//-----------------------------------------------------------------
+static void timer_func(void *arg)
+{
+    int count = (int)(long)arg;
+    int i;
+
+    _in_isr = 1;
+    _isr_calls++;
+    _isr_tick = thread_tick_count();
+
+    for (i=0;i<count;i++)
+        _isr_queued += dpc_queue_irq(dpc_func, (void*)(long)i);
+
+    // Nothing runs until the interrupt returns
+    _isr_runs = _runs;
+
+    _in_isr = 0;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef INCLUDE_OS_TIMER
+    struct dpc_stats stats;
+    int i;
+
+    dpc_init();
+    os_timer_init();
+
+    // Batch queued from the tick runs in order once the interrupt
+    // returns, before this (spinning) thread is resumed
+    os_timer_create(&_timer, timer_func, (void*)BATCH, 1, OS_TIMER_ONE_SHOT | OS_TIMER_TICK_CONTEXT);
+    os_timer_start(&_timer);
+    while (!_isr_calls)
+        ;
+    OS_ASSERT(_isr_runs == 0);
+    OS_ASSERT(_isr_queued == BATCH);
+    OS_ASSERT(_runs == BATCH);
+    OS_ASSERT(_run_tick == _isr_tick);
+    for (i=0;i<BATCH;i++)
+        OS_ASSERT(_order[i] == i);
+
+    // Full queue: the extra call from the interrupt is dropped and
+    // counted, the rest still run in order
+    _runs       = 0;
+    _isr_calls  = 0;
+    _isr_queued = 0;
+    os_timer_create(&_timer, timer_func, (void*)(DPC_ENTRIES + 1), 1, OS_TIMER_ONE_SHOT | OS_TIMER_TICK_CONTEXT);
+    os_timer_start(&_timer);
+    thread_sleep(2);
+    OS_ASSERT(_isr_calls == 1);
+    OS_ASSERT(_isr_runs == 0);
+    OS_ASSERT(_isr_queued == DPC_ENTRIES);
+    OS_ASSERT(_runs == DPC_ENTRIES);
+    for (i=0;i<DPC_ENTRIES;i++)
+        OS_ASSERT(_order[i] == i);
+
+    dpc_get_stats(&stats);
+    printf("queued=%d executed=%d overflows=%d depth_max=%d latency_max=%d\n",
+           stats.queued, stats.executed, stats.overflows, stats.depth_max, stats.latency_max);
+    OS_ASSERT(stats.queued == DPC_ENTRIES + BATCH);
+    OS_ASSERT(stats.executed == DPC_ENTRIES + BATCH);
+    OS_ASSERT(stats.overflows == 1);
+    OS_ASSERT(stats.depth_max == DPC_ENTRIES);
+#endif
+
+    exit(0);
+}
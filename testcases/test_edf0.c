@@ -0,0 +1,94 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_EDF
+THREAD_DECL(edf_a, 1024);
+THREAD_DECL(edf_b, 1024);
+THREAD_DECL(edf_c, 1024);
+THREAD_DECL(edf_late, 1024);
+THREAD_DECL(fixed_hi, 1024);
+THREAD_DECL(fixed_lo, 1024);
+
+static char          _order[8];
+static volatile int  _runs;
+
+//-----------------------------------------------------------------
+// record_func: Record the order threads run in
+//-----------------------------------------------------------------
+static void* record_func(void *arg)
+{
+    _order[_runs++] = (char)(long)arg;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// spin_func: Run past the thread's deadline
+//-----------------------------------------------------------------
+static void* spin_func(void *arg)
+{
+    uint32_t end = (uint32_t)(long)arg;
+
+    while ((int32_t)(thread_tick_count() - end) < 0)
+        ;
+
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_EDF
+    uint32_t now = thread_tick_count();
+
+    // None of these run until this (higher priority) thread blocks
+    THREAD_INIT(edf_a, "edf_a", record_func, (void*)'a', 1);
+    THREAD_INIT(edf_b, "edf_b", record_func, (void*)'b', 1);
+    THREAD_INIT(edf_c, "edf_c", record_func, (void*)'c', 1);
+    THREAD_INIT(fixed_hi, "fixed_hi", record_func, (void*)'H', THREAD_EDF_PRIO + 1);
+    THREAD_INIT(fixed_lo, "fixed_lo", record_func, (void*)'L', THREAD_EDF_PRIO - 1);
+
+    OS_ASSERT(thread_set_policy(&thread_edf_a, THREAD_SCHED_EDF, 0));
+    OS_ASSERT(thread_set_policy(&thread_edf_b, THREAD_SCHED_EDF, 0));
+    OS_ASSERT(thread_set_policy(&thread_edf_c, THREAD_SCHED_EDF, 0));
+    OS_ASSERT(thread_edf_a.priority == THREAD_EDF_PRIO);
+
+    thread_set_deadline(&thread_edf_a, now + 300);
+    thread_set_deadline(&thread_edf_b, now + 100);
+    thread_set_deadline(&thread_edf_c, now + 200);
+
+    // Move the latest deadline to the front
+    thread_set_deadline(&thread_edf_a, now + 50);
+
+    // Fixed priorities above the EDF class first, then earliest deadline
+    // first, then fixed priorities below
+    thread_join(&thread_fixed_lo);
+    printf("Order: %s\n", _order);
+    OS_ASSERT(_runs == 5);
+    OS_ASSERT(_order[0] == 'H');
+    OS_ASSERT(_order[1] == 'a');
+    OS_ASSERT(_order[2] == 'b');
+    OS_ASSERT(_order[3] == 'c');
+    OS_ASSERT(_order[4] == 'L');
+
+    // Nothing ran late
+    OS_ASSERT(thread_edf_misses() == 0);
+
+    // Deadline miss counted once
+    now = thread_tick_count();
+    THREAD_INIT(edf_late, "edf_late", spin_func, (void*)(long)(now + 10), 1);
+    OS_ASSERT(thread_set_policy(&thread_edf_late, THREAD_SCHED_EDF, 0));
+    thread_set_deadline(&thread_edf_late, now + 2);
+    thread_join(&thread_edf_late);
+    OS_ASSERT(thread_edf_late.deadline_misses == 1);
+    OS_ASSERT(thread_edf_misses() == 1);
+
+    // Back to a fixed priority policy
+    OS_ASSERT(thread_set_policy(&thread_edf_a, THREAD_SCHED_RR, 0));
+    OS_ASSERT(thread_edf_a.priority == 1);
+#endif
+
+    exit(0);
+}
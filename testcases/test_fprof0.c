@@ -0,0 +1,155 @@
+#include "test.h"
+#include "kernel/func_profile.h"
+
+// Build with CONFIG_RTOS_FUNC_PROFILE and this file instrumented:
+//   -finstrument-functions -finstrument-functions-exclude-file-list=kernel/,arch/
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define NO_INSTRUMENT   __attribute__((__no_instrument_function__, noinline))
+#define PROFILED        __attribute__((noinline))
+
+#define OUTER_CALLS     4
+
+// Self time of each function (cpu_timenow units)
+#define OUTER_SELF      500000
+#define MIDDLE_SELF     300000
+#define LEAF_SELF       200000
+
+#define SLEEP_TICKS     20
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+//-----------------------------------------------------------------
+// busy: Use CPU for 'duration' (not profiled itself)
+//-----------------------------------------------------------------
+static NO_INSTRUMENT void busy(uint32_t duration)
+{
+    uint64_t start = cpu_timenow();
+
+    while (cpu_timediff(cpu_timenow(), start) < duration)
+        ;
+}
+//-----------------------------------------------------------------
+// Call chain: outer -> 2x middle -> 2x leaf
+//-----------------------------------------------------------------
+static PROFILED void leaf(void)
+{
+    busy(LEAF_SELF);
+}
+static PROFILED void middle(void)
+{
+    leaf();
+    busy(MIDDLE_SELF);
+    leaf();
+}
+static PROFILED void outer(void)
+{
+    middle();
+    busy(OUTER_SELF);
+    middle();
+}
+//-----------------------------------------------------------------
+// sleeper: Mostly switched out, which is not charged
+//-----------------------------------------------------------------
+static PROFILED void sleeper(void)
+{
+    thread_sleep(SLEEP_TICKS);
+}
+//-----------------------------------------------------------------
+// find_func: Totals for a function
+//-----------------------------------------------------------------
+static NO_INSTRUMENT int find_func(void *func, struct func_profile_func *entry)
+{
+    int i;
+
+    for (i=0;i<FUNC_PROFILE_FUNCS;i++)
+        if (func_profile_get_func(i, entry) && entry->func == func)
+            return 1;
+
+    return 0;
+}
+//-----------------------------------------------------------------
+// find_edge: Totals for a caller -> callee edge
+//-----------------------------------------------------------------
+static NO_INSTRUMENT int find_edge(void *caller, void *callee, struct func_profile_edge *entry)
+{
+    int i;
+
+    for (i=0;i<FUNC_PROFILE_EDGES;i++)
+        if (func_profile_get_edge(i, entry) && entry->caller == caller && entry->callee == callee)
+            return 1;
+
+    return 0;
+}
+//-----------------------------------------------------------------
+// check_self: Self time within reason of the expected busy time
+//-----------------------------------------------------------------
+static NO_INSTRUMENT void check_self(struct func_profile_func *f, uint32_t calls, uint64_t self)
+{
+    OS_ASSERT(f->calls == calls);
+    OS_ASSERT(f->exclusive >= self);
+    OS_ASSERT(f->exclusive < self * 2);
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_FUNC_PROFILE
+    struct func_profile_func fo, fm, fl, fs;
+    struct func_profile_edge edge;
+    uint64_t start;
+    int i;
+
+    func_profile_reset();
+
+    for (i=0;i<OUTER_CALLS;i++)
+        outer();
+
+    start = cpu_timenow();
+    sleeper();
+    OS_ASSERT(cpu_timediff(cpu_timenow(), start) > SLEEP_TICKS * LEAF_SELF);
+
+    // Not built with -finstrument-functions: nothing to check
+    if (!find_func((void*)outer, &fo))
+    {
+        printf("Not instrumented, skipped\n");
+        exit(0);
+    }
+
+    OS_ASSERT(find_func((void*)middle, &fm));
+    OS_ASSERT(find_func((void*)leaf, &fl));
+    OS_ASSERT(find_func((void*)sleeper, &fs));
+
+    func_profile_dump(printf);
+
+    // Call counts and self time
+    check_self(&fo, OUTER_CALLS, (uint64_t)OUTER_CALLS * OUTER_SELF);
+    check_self(&fm, OUTER_CALLS * 2, (uint64_t)OUTER_CALLS * 2 * MIDDLE_SELF);
+    check_self(&fl, OUTER_CALLS * 4, (uint64_t)OUTER_CALLS * 4 * LEAF_SELF);
+
+    // Total = self + callees' totals
+    OS_ASSERT(fl.inclusive == fl.exclusive);
+    OS_ASSERT(fm.inclusive == fm.exclusive + fl.inclusive);
+    OS_ASSERT(fo.inclusive == fo.exclusive + fm.inclusive);
+
+    // Call graph edges
+    OS_ASSERT(find_edge((void*)outer, (void*)middle, &edge));
+    OS_ASSERT(edge.calls == OUTER_CALLS * 2 && edge.inclusive == fm.inclusive);
+    OS_ASSERT(find_edge((void*)middle, (void*)leaf, &edge));
+    OS_ASSERT(edge.calls == OUTER_CALLS * 4 && edge.inclusive == fl.inclusive);
+    OS_ASSERT(find_edge((void*)testcase, (void*)outer, &edge));
+    OS_ASSERT(edge.calls == OUTER_CALLS);
+
+    // Time asleep is not charged to the sleeping function
+    OS_ASSERT(fs.calls == 1);
+    OS_ASSERT(fs.inclusive < LEAF_SELF);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,69 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+// Sub-tick delay (cpu_timenow units, ns on the linux port)
+#define HR_DELAY        200000
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_HRTIMER
+THREAD_DECL(poster, 1024);
+
+static struct semaphore _sema;
+
+//-----------------------------------------------------------------
+// poster_func: Post once the waiter has blocked
+//-----------------------------------------------------------------
+static void* poster_func(void *arg)
+{
+    semaphore_post(&_sema);
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_HRTIMER
+    uint64_t start;
+    int64_t elapsed;
+    int i;
+
+    semaphore_init(&_sema, 0);
+
+    // Sub-tick sleeps block until (at least) the requested time
+    for (i=0;i<10;i++)
+    {
+        start = cpu_timenow();
+        thread_sleep_hr(HR_DELAY);
+        elapsed = cpu_timediff(cpu_timenow(), start);
+        OS_ASSERT(elapsed >= HR_DELAY);
+    }
+
+    // Already passed
+    OS_ASSERT(!thread_sleep_hr_until(cpu_timenow() - 1));
+
+    // High resolution timeout expires
+    start = cpu_timenow();
+    OS_ASSERT(!semaphore_timed_pend_hr(&_sema, HR_DELAY));
+    OS_ASSERT(cpu_timediff(cpu_timenow(), start) >= HR_DELAY);
+
+    // Posted before the timeout (which later fires with nothing to wake)
+    THREAD_INIT(poster, "poster", poster_func, NULL, 1);
+    OS_ASSERT(semaphore_timed_pend_hr(&_sema, HR_DELAY * 50));
+
+    // Still works after the stale expiry
+    start = cpu_timenow();
+    thread_sleep_hr(HR_DELAY * 60);
+    OS_ASSERT(cpu_timediff(cpu_timenow(), start) >= HR_DELAY * 60);
+
+    // Tick based sleeps unaffected
+    thread_sleep(2);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,70 @@
+#include "test.h"
+#include "kernel/os_timer.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+// Source the timer callback claims its tick for
+#define TEST_SOURCE     (THREAD_IRQ_SOURCES - 1)
+#define FIRES           5
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#if defined(CONFIG_RTOS_MEASURE_IRQ_TIME) && defined(INCLUDE_OS_TIMER)
+static struct os_timer  _timer;
+static volatile int     _fires;
+
+//-----------------------------------------------------------------
+// timer_func: Runs in the tick interrupt, re-attributes it
+//-----------------------------------------------------------------
+static void timer_func(void *arg)
+{
+    thread_irq_source(TEST_SOURCE);
+    _fires++;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#if defined(CONFIG_RTOS_MEASURE_IRQ_TIME) && defined(INCLUDE_OS_TIMER)
+    struct thread_irq_stats tick_before;
+    struct thread_irq_stats tick;
+    struct thread_irq_stats ext;
+    struct thread_irq_stats src;
+
+    OS_ASSERT(!thread_get_irq_stats(-1, &tick));
+    OS_ASSERT(!thread_get_irq_stats(THREAD_IRQ_SOURCES, &tick));
+
+    os_timer_init();
+    os_timer_create(&_timer, timer_func, NULL, 2, OS_TIMER_AUTO_RELOAD | OS_TIMER_TICK_CONTEXT);
+
+    thread_sleep(2);
+    OS_ASSERT(thread_get_irq_stats(THREAD_IRQ_TICK, &tick_before));
+    OS_ASSERT(tick_before.count > 0);
+
+    os_timer_start(&_timer);
+    while (_fires < FIRES)
+        thread_sleep(1);
+    os_timer_stop(&_timer);
+
+    OS_ASSERT(thread_get_irq_stats(THREAD_IRQ_TICK, &tick));
+    OS_ASSERT(thread_get_irq_stats(THREAD_IRQ_EXT, &ext));
+    OS_ASSERT(thread_get_irq_stats(TEST_SOURCE, &src));
+
+    thread_dump_irq_stats(printf);
+
+    // Re-attributed interrupts are counted against the named source only
+    OS_ASSERT(src.count == FIRES);
+    OS_ASSERT(src.total > 0);
+    OS_ASSERT(src.max > 0);
+    OS_ASSERT(tick.count > tick_before.count);
+
+    // No external interrupts on this platform
+    OS_ASSERT(ext.count == 0);
+#endif
+
+    exit(0);
+}
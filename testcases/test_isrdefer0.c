@@ -0,0 +1,170 @@
+#include "test.h"
+#include "kernel/os_timer.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define HELD_TICKS      2
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#if defined(CONFIG_RTOS_ISR_DEFER) && defined(INCLUDE_OS_TIMER)
+THREAD_DECL(waiter, 1024);
+
+static struct os_timer  _timer;
+static struct semaphore _sema;
+
+static volatile int     _cb_calls;
+static volatile uint32_t _cb_value;
+static volatile uint32_t _cb_tick;
+static volatile int     _woken;
+static volatile uint32_t _woken_tick;
+
+static int              _order[THREAD_ISR_QUEUE_ENTRIES + 1];
+static volatile int     _order_len;
+
+//-----------------------------------------------------------------
+// timer_func: Post from the tick interrupt
+//-----------------------------------------------------------------
+static void timer_func(void *arg)
+{
+    int count = (int)(long)arg;
+    int i;
+
+    for (i=0;i<count;i++)
+        semaphore_post_irq(&_sema);
+
+    // Only what did not fit in the queue has been applied yet
+    _cb_value = semaphore_get_value(&_sema);
+    _cb_tick  = thread_tick_count();
+    _cb_calls++;
+}
+//-----------------------------------------------------------------
+// post_from_tick: Post 'count' times from the next tick and wait
+//-----------------------------------------------------------------
+static void post_from_tick(int count)
+{
+    _cb_calls = 0;
+    os_timer_create(&_timer, timer_func, (void*)(long)count, 1, OS_TIMER_ONE_SHOT | OS_TIMER_TICK_CONTEXT);
+    os_timer_start(&_timer);
+    while (!_cb_calls)
+        ;
+}
+//-----------------------------------------------------------------
+// waiter_func: Higher priority than the test thread
+//-----------------------------------------------------------------
+static void* waiter_func(void *arg)
+{
+    semaphore_pend(&_sema);
+    _woken_tick = thread_tick_count();
+    _woken++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// record_func: Request which records the order it is applied in
+//-----------------------------------------------------------------
+static void record_func(void *arg)
+{
+    _order[_order_len++] = (int)(long)arg;
+}
+//-----------------------------------------------------------------
+// post_func: Request which posts as an interrupt handler would
+//-----------------------------------------------------------------
+static void post_func(void *arg)
+{
+    semaphore_post_irq((struct semaphore *)arg);
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#if defined(CONFIG_RTOS_ISR_DEFER) && defined(INCLUDE_OS_TIMER)
+    struct thread_isr_queue_stats before;
+    struct thread_isr_queue_stats after;
+    uint32_t ticks;
+    int cr;
+    int i;
+
+    semaphore_init(&_sema, 0);
+    os_timer_init();
+
+    // Post from the tick is queued, not applied in the interrupt, but
+    // visible by the time the interrupted thread resumes
+    thread_isr_defer_stats(&before);
+    post_from_tick(1);
+    OS_ASSERT(_cb_value == 0);
+    OS_ASSERT(semaphore_try(&_sema));
+    thread_isr_defer_stats(&after);
+    OS_ASSERT(after.requests == before.requests + 1);
+    OS_ASSERT(after.overflows == before.overflows);
+
+    // A thread pending on it runs in the same tick
+    THREAD_INIT(waiter, "waiter", waiter_func, NULL, THREAD_MAX_PRIO);
+    thread_sleep(THREAD_YIELD);
+    post_from_tick(1);
+    OS_ASSERT(_woken == 1);
+    OS_ASSERT(_woken_tick == _cb_tick);
+    OS_ASSERT(semaphore_get_value(&_sema) == 0);
+
+    // Queue full: drained in the interrupt, then the overflowing post
+    // applied there, the one after it queued again
+    thread_isr_defer_stats(&before);
+    post_from_tick(THREAD_ISR_QUEUE_ENTRIES + 2);
+    OS_ASSERT(_cb_value == THREAD_ISR_QUEUE_ENTRIES + 1);
+    OS_ASSERT(semaphore_get_value(&_sema) == THREAD_ISR_QUEUE_ENTRIES + 2);
+    thread_isr_defer_stats(&after);
+    OS_ASSERT(after.requests == before.requests + THREAD_ISR_QUEUE_ENTRIES + 1);
+    OS_ASSERT(after.overflows == before.overflows + 1);
+    OS_ASSERT(after.depth_max == THREAD_ISR_QUEUE_ENTRIES);
+    semaphore_init(&_sema, 0);
+
+    // Overflow keeps requests in the order they were made
+    cr = critical_start();
+    for (i=0;i<THREAD_ISR_QUEUE_ENTRIES + 1;i++)
+        OS_ASSERT(thread_isr_defer(record_func, (void*)(long)i));
+    OS_ASSERT(_order_len == THREAD_ISR_QUEUE_ENTRIES + 1);
+    for (i=0;i<THREAD_ISR_QUEUE_ENTRIES + 1;i++)
+        OS_ASSERT(_order[i] == i);
+    critical_end(cr);
+    _order_len = 0;
+
+    // Queued with no interrupt exit since: applied at the next kernel
+    // entry so semaphore_try does not see a stale count
+    cr = critical_start();
+    OS_ASSERT(thread_isr_defer(post_func, &_sema));
+    OS_ASSERT(semaphore_get_value(&_sema) == 0);
+    OS_ASSERT(semaphore_try(&_sema));
+    critical_end(cr);
+
+    // Kernel lock held: ticks and requests wait for the unlock
+    thread_isr_defer_stats(&before);
+    cr = thread_kernel_lock();
+    ticks = thread_tick_count();
+
+    for (i=0;i<THREAD_ISR_QUEUE_ENTRIES;i++)
+        OS_ASSERT(thread_isr_defer(record_func, (void*)(long)i));
+
+    do
+        thread_isr_defer_stats(&after);
+    while (after.ticks_deferred < before.ticks_deferred + HELD_TICKS);
+
+    OS_ASSERT(thread_tick_count() == ticks);
+    OS_ASSERT(_order_len == 0);
+
+    thread_kernel_unlock(cr);
+
+    OS_ASSERT(thread_tick_count() >= ticks + HELD_TICKS);
+    OS_ASSERT(_order_len == THREAD_ISR_QUEUE_ENTRIES);
+    for (i=0;i<THREAD_ISR_QUEUE_ENTRIES;i++)
+        OS_ASSERT(_order[i] == i);
+
+    thread_isr_defer_stats(&after);
+    printf("requests=%d overflows=%d depth_max=%d ticks_deferred=%d\n",
+           after.requests, after.overflows, after.depth_max, after.ticks_deferred);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,170 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define YIELDS          8
+#define SPIN_TICKS      10
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(peer1, 1024);
+THREAD_DECL(peer2, 1024);
+THREAD_DECL(high, 1024);
+THREAD_DECL(equal, 1024);
+THREAD_DECL(spin0, 1024);
+THREAD_DECL(spin1, 1024);
+THREAD_DECL(spin2, 1024);
+
+static struct semaphore _sema;
+static int              _order[YIELDS * 2];
+static volatile int     _order_len;
+static volatile int     _high_runs;
+static volatile int     _equal_runs;
+static volatile int     _low_runs;
+
+static volatile int     _stop;
+static volatile int     _owner;
+static volatile int     _switches;
+
+//-----------------------------------------------------------------
+// yield_func: Record turn then yield to the equal priority peer
+//-----------------------------------------------------------------
+static void* yield_func(void *arg)
+{
+    int i;
+
+    for (i=0;i<YIELDS;i++)
+    {
+        _order[_order_len++] = (int)(long)arg;
+        thread_sleep(THREAD_YIELD);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// high_func: Higher priority than the test thread
+//-----------------------------------------------------------------
+static void* high_func(void *arg)
+{
+    semaphore_pend(&_sema);
+    _high_runs++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// equal_func: Same priority as the test thread
+//-----------------------------------------------------------------
+static void* equal_func(void *arg)
+{
+    semaphore_pend(&_sema);
+    _equal_runs++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// spin_func: Spin until stopped, counting changes of owner
+//-----------------------------------------------------------------
+static void* spin_func(void *arg)
+{
+    int id = (int)(long)arg;
+
+    while (!_stop)
+    {
+        if (_owner != id)
+        {
+            _owner = id;
+            _switches++;
+        }
+        if (id == 0)
+            _low_runs++;
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct thread *self = thread_current();
+    uint32_t run_count;
+    uint32_t ticks;
+    int cr;
+    int i;
+
+    semaphore_init(&_sema, 0);
+
+    // Yield with no equal priority peer: picked again, pick counted
+    // (tick masked so it cannot add a pick of its own)
+    cr = critical_start();
+    run_count = self->run_count;
+    thread_sleep(THREAD_YIELD);
+    OS_ASSERT(thread_current() == self);
+    OS_ASSERT(self->run_count == run_count + 1);
+    critical_end(cr);
+
+    // Yield between equal priority peers: strict round-robin order
+    // (FIFO so the tick does not rotate them as well)
+    THREAD_INIT(peer1, "peer1", yield_func, (void*)1, 1);
+    THREAD_INIT(peer2, "peer2", yield_func, (void*)2, 1);
+    thread_set_policy(&thread_peer1, THREAD_SCHED_FIFO, 0);
+    thread_set_policy(&thread_peer2, THREAD_SCHED_FIFO, 0);
+    thread_join(&thread_peer1);
+    thread_join(&thread_peer2);
+
+    OS_ASSERT(_order_len == YIELDS * 2);
+    for (i=0;i<YIELDS * 2;i++)
+        OS_ASSERT(_order[i] == 1 + (i & 1));
+
+    // Higher priority wake switches before the post returns
+    THREAD_INIT(high, "high", high_func, NULL, self->priority + 1);
+    thread_sleep(THREAD_YIELD);     // let it pend first
+    OS_ASSERT(_high_runs == 0);
+    semaphore_post(&_sema);
+    OS_ASSERT(_high_runs == 1);
+
+    // Equal priority wake does not even enter the scheduler, the woken
+    // thread runs on the next yield
+    THREAD_INIT(equal, "equal", equal_func, NULL, self->priority);
+    thread_sleep(THREAD_YIELD);     // let it pend first
+    cr = critical_start();
+    run_count = self->run_count;
+    semaphore_post(&_sema);
+    OS_ASSERT(_equal_runs == 0);
+    OS_ASSERT(self->run_count == run_count);
+    critical_end(cr);
+    thread_sleep(THREAD_YIELD);
+    OS_ASSERT(_equal_runs == 1);
+
+    // Ticks with nothing to switch to keep the current thread running,
+    // counting a pick each time, and lower priority threads never run
+    THREAD_INIT(spin0, "spin0", spin_func, (void*)0, 1);
+    run_count = self->run_count;
+    ticks = thread_tick_count();
+    while (thread_tick_count() < ticks + SPIN_TICKS)
+        ;
+    OS_ASSERT(_low_runs == 0);
+    OS_ASSERT(self->run_count - run_count >= SPIN_TICKS);
+    OS_ASSERT(self->run_count - run_count <= SPIN_TICKS + 1);
+    _stop = 1;
+    thread_join(&thread_spin0);
+
+    // Preempted (not yielding) thread resumes ahead of its equal
+    // priority peer once the higher priority thread sleeps again
+    _stop     = 0;
+    _owner    = 0;
+    _switches = 0;
+    THREAD_INIT(spin1, "spin1", spin_func, (void*)1, 1);
+    THREAD_INIT(spin2, "spin2", spin_func, (void*)2, 1);
+    thread_set_policy(&thread_spin1, THREAD_SCHED_FIFO, 0);
+    thread_set_policy(&thread_spin2, THREAD_SCHED_FIFO, 0);
+    for (i=0;i<SPIN_TICKS;i++)
+        thread_sleep(1);
+    OS_ASSERT(_owner == 1);
+    OS_ASSERT(_switches == 1);
+    _stop = 1;
+    thread_join(&thread_spin1);
+    thread_join(&thread_spin2);
+
+    exit(0);
+}
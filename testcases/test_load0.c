@@ -0,0 +1,90 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define MAX_THREADS     8
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+THREAD_DECL(hog, 1024);
+
+static volatile int _hog_run;
+
+//-----------------------------------------------------------------
+// hog_func: Use all the CPU the test thread does not
+//-----------------------------------------------------------------
+static void* hog_func(void *arg)
+{
+    while (_hog_run)
+        ;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// find_load: Find thread in a load snapshot
+//-----------------------------------------------------------------
+static struct thread_load *find_load(struct thread_load *load, int count, struct thread *pThread)
+{
+    int i;
+
+    for (i=0;i<count;i++)
+        if (load[i].thread == pThread)
+            return &load[i];
+
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_MEASURE_THREAD_TIME
+    struct thread_load load[MAX_THREADS];
+    struct thread_load again[MAX_THREADS];
+    struct thread_load *hog;
+    int count;
+    int i;
+
+    // Lower priority busy thread takes the CPU while this one sleeps.
+    // First window end only syncs it, the next two are full samples.
+    _hog_run = 1;
+    THREAD_INIT(hog, "hog", hog_func, NULL, 1);
+    thread_sleep(THREAD_LOAD_WINDOW * 3 + THREAD_LOAD_UPDATE_MAX);
+
+    count = thread_get_load(load, MAX_THREADS);
+    OS_ASSERT(count >= 3);
+    hog = find_load(load, count, &thread_hog);
+    OS_ASSERT(hog != NULL);
+
+    printf("busy: hog %d/%d/%d system %d\n", hog->load[0], hog->load[THREAD_LOAD_AVG_COUNT / 2],
+           hog->load[THREAD_LOAD_AVG_COUNT - 1], thread_get_system_load(0));
+
+    OS_ASSERT(hog->load[0] > 900);
+    OS_ASSERT(thread_get_system_load(0) > 900);
+
+    // Slower averages are still catching up
+    for (i=1;i<THREAD_LOAD_AVG_COUNT;i++)
+        OS_ASSERT(hog->load[i] <= hog->load[0]);
+
+    // Reading does not clear anything
+    OS_ASSERT(thread_get_load(again, MAX_THREADS) == count);
+    for (i=0;i<count;i++)
+    {
+        OS_ASSERT(again[i].thread == load[i].thread);
+        OS_ASSERT(again[i].run_time >= load[i].run_time);
+        OS_ASSERT(again[i].load[0] == load[i].load[0]);
+    }
+
+    // Hog exits: a full window later the system is idle
+    _hog_run = 0;
+    thread_sleep(THREAD_LOAD_WINDOW * 2 + THREAD_LOAD_UPDATE_MAX);
+
+    printf("idle: system %d/%d\n", thread_get_system_load(0), thread_get_system_load(THREAD_LOAD_AVG_COUNT - 1));
+    OS_ASSERT(thread_get_system_load(0) < 100);
+#endif
+
+    exit(0);
+}
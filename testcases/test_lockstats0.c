@@ -0,0 +1,135 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define HOLD_TICKS      3
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_LOCK_STATS
+THREAD_DECL(contender, 1024);
+THREAD_DECL(waiter1, 1024);
+THREAD_DECL(waiter2, 1024);
+
+static struct mutex     _mtx;
+static struct semaphore _sema;
+static volatile int     _done;
+
+//-----------------------------------------------------------------
+// contender_func: Blocks on the mutex held by the test thread
+//-----------------------------------------------------------------
+static void* contender_func(void *arg)
+{
+    mutex_lock(&_mtx);
+    _done++;
+    mutex_unlock(&_mtx);
+    return NULL;
+}
+//-----------------------------------------------------------------
+// waiter_func: Pend on the semaphore
+//-----------------------------------------------------------------
+static void* waiter_func(void *arg)
+{
+    semaphore_pend(&_sema);
+    _done++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// registry_count: Number of instrumented objects
+//-----------------------------------------------------------------
+static int registry_count(void)
+{
+    struct lock_stats *s;
+    int count = 0;
+
+    for (s = lock_stats_first(); s; s = s->next)
+        count++;
+
+    return count;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_LOCK_STATS
+    struct semaphore local;
+    int count;
+
+    mutex_init(&_mtx, 0);
+    semaphore_init(&_sema, 0);
+    lock_stats_set_name(&_mtx.stats, "mtx");
+    lock_stats_set_name(&_sema.stats, "sema");
+
+    // Re-initialising does not add a second registry entry
+    count = registry_count();
+    semaphore_init(&_sema, 0);
+    lock_stats_set_name(&_sema.stats, "sema");
+    OS_ASSERT(registry_count() == count);
+
+    // Object on the stack is removed before it goes out of scope
+    semaphore_init(&local, 0);
+    OS_ASSERT(registry_count() == count + 1);
+    lock_stats_remove(&local.stats);
+    OS_ASSERT(registry_count() == count);
+    OS_ASSERT(_sema.stats.registered && _mtx.stats.registered);
+
+    // Uncontended
+    mutex_lock(&_mtx);
+    mutex_unlock(&_mtx);
+    OS_ASSERT(_mtx.stats.acquisitions == 1);
+    OS_ASSERT(_mtx.stats.contended == 0);
+
+    // Contended: the other thread waits while this one holds the mutex
+    mutex_lock(&_mtx);
+    THREAD_INIT(contender, "contender", contender_func, NULL, THREAD_MAX_PRIO);
+    thread_sleep(HOLD_TICKS);
+    OS_ASSERT(_done == 0);
+    OS_ASSERT(_mtx.stats.depth == 1);
+    mutex_unlock(&_mtx);
+    OS_ASSERT(_done == 1);
+
+    OS_ASSERT(_mtx.stats.acquisitions == 3);
+    OS_ASSERT(_mtx.stats.contended == 1);
+    OS_ASSERT(_mtx.stats.wait_max > 0);
+    OS_ASSERT(_mtx.stats.wait_total == _mtx.stats.wait_max);
+    OS_ASSERT(_mtx.stats.depth == 0);
+    OS_ASSERT(_mtx.stats.depth_max == 1);
+    OS_ASSERT(_mtx.stats.hold_max >= _mtx.stats.wait_max);
+
+    // Timeouts wait (and count as contended) without acquiring
+    OS_ASSERT(!semaphore_timed_pend(&_sema, 2));
+    OS_ASSERT(!semaphore_timed_pend(&_sema, 2));
+    OS_ASSERT(_sema.stats.acquisitions == 0);
+    OS_ASSERT(_sema.stats.contended == 2);
+    OS_ASSERT(_sema.stats.wait_max > 0);
+    OS_ASSERT(_sema.stats.depth == 0);
+    OS_ASSERT(_sema.stats.depth_max == 1);
+
+    // Two waiters queued at once
+    THREAD_INIT(waiter1, "waiter1", waiter_func, NULL, THREAD_MAX_PRIO);
+    THREAD_INIT(waiter2, "waiter2", waiter_func, NULL, THREAD_MAX_PRIO);
+    thread_sleep(1);
+    OS_ASSERT(_sema.stats.depth == 2);
+    semaphore_post(&_sema);
+    semaphore_post(&_sema);
+    OS_ASSERT(_done == 3);
+
+    OS_ASSERT(_sema.stats.acquisitions == 2);
+    OS_ASSERT(_sema.stats.contended == 4);
+    OS_ASSERT(_sema.stats.depth == 0);
+    OS_ASSERT(_sema.stats.depth_max == 2);
+
+    lock_stats_report(printf, 4);
+
+    // Reset keeps the registry entry
+    lock_stats_reset(&_sema.stats);
+    OS_ASSERT(_sema.stats.contended == 0);
+    OS_ASSERT(registry_count() == count);
+#endif
+
+    exit(0);
+}
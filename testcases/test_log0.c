@@ -0,0 +1,123 @@
+#include "test.h"
+#include "kernel/log.h"
+#include "kernel/os_timer.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define TICK_LOGS       3
+#define DROPS           5
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#if defined(INCLUDE_LOG) && defined(INCLUDE_OS_TIMER)
+static const char       _thread_fmt[] = "thread %ld\n";
+static const char       _tick_fmt[] = "tick %ld\n";
+
+static struct os_timer  _timer;
+static volatile int     _tick_logs;
+static char             _out[256];
+
+//-----------------------------------------------------------------
+// timer_func: Log from the tick interrupt
+//-----------------------------------------------------------------
+static void timer_func(void *arg)
+{
+    if (_tick_logs < TICK_LOGS || arg)
+        LOG1(_tick_fmt, ++_tick_logs);
+}
+//-----------------------------------------------------------------
+// out_printf: Capture formatted output
+//-----------------------------------------------------------------
+static int out_printf(const char* fmt, ...)
+{
+    va_list args;
+    int len = strlen(_out);
+
+    va_start(args, fmt);
+    len = vsnprintf(&_out[len], sizeof(_out) - len, fmt, args);
+    va_end(args);
+
+    return len;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#if defined(INCLUDE_LOG) && defined(INCLUDE_OS_TIMER)
+    struct log_record rec;
+    uint64_t start;
+    uint64_t ts;
+    uint64_t last;
+    int i;
+
+    // Manual drain
+    log_init(NULL, 0);
+    os_timer_init();
+    OS_ASSERT(!log_read(&rec));
+
+    // Thread, then tick context, then thread again
+    start = cpu_timenow();
+    LOG1(_thread_fmt, 1);
+    os_timer_create(&_timer, timer_func, NULL, 1, OS_TIMER_AUTO_RELOAD | OS_TIMER_TICK_CONTEXT);
+    os_timer_start(&_timer);
+    while (_tick_logs < TICK_LOGS)
+        thread_sleep(1);
+    os_timer_stop(&_timer);
+    LOG1(_thread_fmt, 2);
+
+    // Read back in the order written, timestamps not going backwards
+    last = start;
+    OS_ASSERT(log_read(&rec));
+    OS_ASSERT(rec.fmt == _thread_fmt && rec.args[0] == 1);
+    OS_ASSERT(rec.timestamp >= last);
+    last = rec.timestamp;
+
+    for (i=1;i<=TICK_LOGS;i++)
+    {
+        OS_ASSERT(log_read(&rec));
+        OS_ASSERT(rec.fmt == _tick_fmt && rec.args[0] == i);
+        OS_ASSERT(rec.timestamp >= last);
+        last = rec.timestamp;
+    }
+
+    OS_ASSERT(log_read(&rec));
+    OS_ASSERT(rec.fmt == _thread_fmt && rec.args[0] == 2);
+    OS_ASSERT(rec.timestamp >= last);
+    OS_ASSERT(!log_read(&rec));
+    OS_ASSERT(log_overflows() == 0);
+
+    // Fill the ring, further thread writes are dropped and counted
+    for (i=0;i<LOG_ENTRIES + DROPS;i++)
+        LOG1(_thread_fmt, i);
+    OS_ASSERT(log_overflows() == DROPS);
+
+    // As are writes from the tick
+    _tick_logs = 0;
+    os_timer_create(&_timer, timer_func, (void*)1, 1, OS_TIMER_ONE_SHOT | OS_TIMER_TICK_CONTEXT);
+    os_timer_start(&_timer);
+    thread_sleep(2);
+    OS_ASSERT(_tick_logs == 1);
+    OS_ASSERT(log_overflows() == DROPS + 1);
+
+    // Oldest records kept, full 64-bit timestamp printed
+    start = cpu_timenow();
+    OS_ASSERT(log_drain(out_printf, 1) == 1);
+    printf("%s", _out);
+    OS_ASSERT(_out[0] == '[' && _out[17] == ']');
+    ts = strtoull(&_out[1], NULL, 16);
+    OS_ASSERT(ts <= start && ts >= last);
+    OS_ASSERT(!strcmp(&_out[18], " thread 0\n"));
+
+    OS_ASSERT(log_drain(out_printf, LOG_ENTRIES) == LOG_ENTRIES - 1);
+    OS_ASSERT(!log_read(&rec));
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,78 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define PERIOD          5
+#define JOBS            10
+#define OVERRUN_TICKS   12
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(periodic, 1024);
+
+static uint32_t _first_release;
+static uint32_t _start[JOBS];
+static uint32_t _missed;
+
+//-----------------------------------------------------------------
+// periodic_func: Record the tick each job starts on
+//-----------------------------------------------------------------
+static void* periodic_func(void *arg)
+{
+    uint32_t end;
+    int i;
+
+    thread_set_period(thread_current(), PERIOD, _first_release);
+
+    for (i=0;i<JOBS;i++)
+    {
+        OS_ASSERT(thread_wait_next_period() == 0);
+        _start[i] = thread_tick_count();
+
+        // Some work, less than a period
+        thread_sleep(1);
+    }
+
+    // Overrun: job runs past two release points
+    thread_wait_next_period();
+    end = thread_tick_count() + OVERRUN_TICKS;
+    while ((int32_t)(thread_tick_count() - end) < 0)
+        ;
+    _missed = thread_wait_next_period();
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct thread_period_stats stats;
+    uint32_t now;
+    int i;
+
+    // Absolute sleep
+    now = thread_tick_count();
+    OS_ASSERT(thread_sleep_until(now + 3));
+    OS_ASSERT(thread_tick_count() == now + 3);
+    OS_ASSERT(!thread_sleep_until(now));
+
+    // Periodic releases do not drift
+    _first_release = thread_tick_count() + 2;
+    THREAD_INIT(periodic, "periodic", periodic_func, NULL, THREAD_MAX_PRIO);
+    thread_join(&thread_periodic);
+
+    for (i=0;i<JOBS;i++)
+        OS_ASSERT(_start[i] == _first_release + (i * PERIOD));
+
+    thread_get_period_stats(&thread_periodic, &stats);
+    printf("releases=%d overruns=%d jitter_max=%d missed=%d\n", stats.releases, stats.overruns, stats.jitter_max, _missed);
+    OS_ASSERT(stats.releases == JOBS + 2);
+    OS_ASSERT(_missed == 2);
+    OS_ASSERT(stats.overruns == 2);
+    OS_ASSERT(stats.jitter_max == OVERRUN_TICKS - (2 * PERIOD));
+
+    exit(0);
+}
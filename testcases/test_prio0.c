@@ -0,0 +1,97 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(low, 1024);
+THREAD_DECL(mid, 1024);
+THREAD_DECL(sleeper, 1024);
+
+static volatile int _low_runs;
+static volatile int _mid_runs;
+static volatile int _sleeper_runs;
+static struct semaphore _sema;
+
+//-----------------------------------------------------------------
+// low_func: Count each time it gets to run
+//-----------------------------------------------------------------
+static void* low_func(void *arg)
+{
+    while (1)
+    {
+        _low_runs++;
+        semaphore_pend(&_sema);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// mid_func: Count each time it gets to run
+//-----------------------------------------------------------------
+static void* mid_func(void *arg)
+{
+    while (1)
+    {
+        _mid_runs++;
+        thread_sleep(1);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// sleeper_func: Run once after a long sleep
+//-----------------------------------------------------------------
+static void* sleeper_func(void *arg)
+{
+    thread_sleep(5);
+    _sleeper_runs++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct thread *self = thread_current();
+    int cr;
+
+    semaphore_init(&_sema, 0);
+
+    THREAD_INIT(low, "low", low_func, NULL, 1);
+    THREAD_INIT(sleeper, "sleeper", sleeper_func, NULL, 1);
+
+    // Boost a run-able thread above this one: runs before the call returns
+    cr = critical_start();
+    OS_ASSERT(_low_runs == 0);
+    OS_ASSERT(thread_set_priority(&thread_low, THREAD_MAX_PRIO));
+    OS_ASSERT(_low_runs == 1);
+    OS_ASSERT(thread_low.priority == THREAD_MAX_PRIO);
+    critical_end(cr);
+
+    // Boost a blocked (pending) thread: runs as soon as it is woken
+    semaphore_post(&_sema);
+    OS_ASSERT(_low_runs == 2);
+
+    // Drop it again below this thread: no longer preempts on wake
+    OS_ASSERT(thread_set_priority(&thread_low, 1));
+    semaphore_post(&_sema);
+    OS_ASSERT(_low_runs == 2);
+
+    // Boost a sleeping thread: preempts this one when its sleep expires
+    OS_ASSERT(thread_set_priority(&thread_sleeper, THREAD_MAX_PRIO));
+    while (!_sleeper_runs)
+        ;
+
+    // Lower this thread below a run-able thread: switches immediately
+    THREAD_INIT(mid, "mid", mid_func, NULL, 5);
+    OS_ASSERT(_mid_runs == 0);
+    cr = critical_start();
+    OS_ASSERT(thread_set_priority(self, 2));
+    OS_ASSERT(_mid_runs == 1);
+    critical_end(cr);
+
+    // Idle task priority cannot be used
+    OS_ASSERT(!thread_set_priority(self, THREAD_IDLE_PRIO));
+
+    exit(0);
+}
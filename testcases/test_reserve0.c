@@ -0,0 +1,79 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define PERIOD          10
+#define RUN_TICKS       100
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+THREAD_DECL(hog, 1024);
+THREAD_DECL(worker, 1024);
+
+static struct thread_reservation _res;
+static volatile int      _stop;
+static volatile uint32_t _worker_runs;
+
+//-----------------------------------------------------------------
+// hog_func: High priority thread which never blocks
+//-----------------------------------------------------------------
+static void* hog_func(void *arg)
+{
+    while (!_stop)
+        ;
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// worker_func: Low priority thread, starved without a reservation
+//-----------------------------------------------------------------
+static void* worker_func(void *arg)
+{
+    while (!_stop)
+        _worker_runs++;
+
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_CPU_RESERVATION
+    uint64_t budget;
+    uint64_t start;
+
+    // Calibrate: roughly 3 ticks of CPU time per period
+    start = cpu_timenow();
+    thread_sleep(PERIOD);
+    budget = (cpu_timediff(cpu_timenow(), start) * 3) / (PERIOD + 1);
+
+    thread_reservation_init(&_res, budget, PERIOD, 1);
+
+    THREAD_INIT(worker, "worker", worker_func, NULL, 2);
+    THREAD_INIT(hog, "hog", hog_func, NULL, THREAD_MAX_PRIO);
+    thread_reservation_attach(&thread_hog, &_res);
+
+    // Hog runs first, but is demoted below the worker (and this thread)
+    // once its budget is used up each period
+    thread_sleep(RUN_TICKS);
+
+    printf("exhaustions=%d worker_runs=%d\n", _res.exhaustions, _worker_runs);
+    OS_ASSERT(_res.exhaustions >= (RUN_TICKS / PERIOD) - 2);
+    OS_ASSERT(_worker_runs > 0);
+
+    // Stops at the next demotion
+    _stop = 1;
+    thread_join(&thread_hog);
+    thread_join(&thread_worker);
+
+    // Set priority is restored once replenished
+    OS_ASSERT(thread_hog.base_priority == THREAD_MAX_PRIO);
+#endif
+
+    exit(0);
+}
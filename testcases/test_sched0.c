@@ -0,0 +1,87 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define RUN_TICKS       40
+#define RR_QUANTUM      5
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#define PAIRS           3
+
+static struct thread     _threads[PAIRS][2];
+static stk_t             _stacks[PAIRS][2][1024];
+static int               _pair;
+
+static volatile int      _owner;
+static volatile int      _switches;
+static volatile uint32_t _end_tick;
+
+//-----------------------------------------------------------------
+// thread_func: Spin until the end tick, counting changes of owner
+//-----------------------------------------------------------------
+static void* thread_func(void *arg)
+{
+    int id = (int)(long)arg;
+
+    while (thread_tick_count() < _end_tick)
+    {
+        if (_owner != id)
+        {
+            _owner = id;
+            _switches++;
+        }
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// run_pair: Run two spinning threads at the same priority & policy
+//-----------------------------------------------------------------
+static int run_pair(tThreadPolicy policy, uint32_t quantum)
+{
+    struct thread *t = _threads[_pair];
+
+    _owner    = 0;
+    _switches = 0;
+    _end_tick = thread_tick_count() + RUN_TICKS;
+
+    // Lower priority than this thread so neither runs until the join
+    thread_init(&t[0], "thread0", 1, thread_func, (void*)1, _stacks[_pair][0], 1024);
+    thread_init(&t[1], "thread1", 1, thread_func, (void*)2, _stacks[_pair][1], 1024);
+    thread_set_policy(&t[0], policy, quantum);
+    thread_set_policy(&t[1], policy, quantum);
+
+    thread_join(&t[0]);
+    thread_join(&t[1]);
+
+    _pair++;
+    return _switches;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    int switches;
+
+    // FIFO: thread0 runs to the end tick before thread1 starts
+    switches = run_pair(THREAD_SCHED_FIFO, 0);
+    printf("FIFO: %d switches\n", switches);
+    OS_ASSERT(switches == 1);
+
+    // RR: alternate every RR_QUANTUM ticks
+    switches = run_pair(THREAD_SCHED_RR, RR_QUANTUM);
+    printf("RR(%d): %d switches\n", RR_QUANTUM, switches);
+    OS_ASSERT(switches >= (RUN_TICKS / RR_QUANTUM) - 2);
+    OS_ASSERT(switches <= (RUN_TICKS / RR_QUANTUM) + 3);
+
+    // Default: alternate every tick
+    switches = run_pair(THREAD_SCHED_RR, 0);
+    printf("RR(%d): %d switches\n", THREAD_DEFAULT_QUANTUM, switches);
+    OS_ASSERT(switches > (RUN_TICKS / RR_QUANTUM) + 3);
+
+    exit(0);
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(high, 1024);
+
+static volatile int _high_runs;
+static struct semaphore _sema;
+
+//-----------------------------------------------------------------
+// high_func: Count each time it gets to run
+//-----------------------------------------------------------------
+static void* high_func(void *arg)
+{
+    while (1)
+    {
+        _high_runs++;
+        semaphore_pend(&_sema);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// spin_ticks: Busy wait (no blocking) for a number of ticks
+//-----------------------------------------------------------------
+static void spin_ticks(uint32_t ticks)
+{
+    uint32_t end = thread_tick_count() + ticks;
+
+    while ((int32_t)(thread_tick_count() - end) < 0)
+        ;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    semaphore_init(&_sema, 0);
+
+    // Higher priority thread made run-able while locked (ticks continue)
+    thread_sched_lock();
+    thread_sched_lock();
+    THREAD_INIT(high, "high", high_func, NULL, THREAD_MAX_PRIO);
+    spin_ticks(3);
+    OS_ASSERT(_high_runs == 0);
+
+    // Still nested
+    thread_sched_unlock();
+    OS_ASSERT(_high_runs == 0);
+
+    // Deferred switch happens on the final unlock
+    thread_sched_unlock();
+    OS_ASSERT(_high_runs == 1);
+
+    // Wakeup while locked
+    thread_sched_lock();
+    semaphore_post(&_sema);
+    OS_ASSERT(_high_runs == 1);
+    thread_sched_unlock();
+    OS_ASSERT(_high_runs == 2);
+
+    // Blocking while locked lets other threads run
+    thread_sched_lock();
+    semaphore_post(&_sema);
+    thread_sleep(1);
+    OS_ASSERT(_high_runs == 3);
+    thread_sched_unlock();
+
+    // Nothing pending: no switch
+    semaphore_post(&_sema);
+    OS_ASSERT(_high_runs == 4);
+
+    exit(0);
+}
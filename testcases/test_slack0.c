@@ -0,0 +1,75 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define OTHER_SLEEP     10
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(other, 1024);
+
+static struct semaphore _go;
+static struct semaphore _never;
+static uint32_t         _other_woke;
+
+//-----------------------------------------------------------------
+// other_func: Exact sleep which slack sleepers can share
+//-----------------------------------------------------------------
+static void* other_func(void *arg)
+{
+    while (1)
+    {
+        semaphore_pend(&_go);
+        thread_sleep(OTHER_SLEEP);
+        _other_woke = thread_tick_count();
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    uint32_t now;
+
+    semaphore_init(&_go, 0);
+    semaphore_init(&_never, 0);
+    THREAD_INIT(other, "other", other_func, NULL, THREAD_MAX_PRIO);
+
+    // Let the other thread start and wait on _go
+    thread_sleep(1);
+
+    // Shorter sleep with enough slack: woken with the other thread
+    semaphore_post(&_go);
+    thread_sleep_slack(OTHER_SLEEP - 2, 3);
+    OS_ASSERT(_other_woke != 0);
+    OS_ASSERT(thread_tick_count() == _other_woke);
+    OS_ASSERT(thread_sleep_coalesced() == 1);
+
+    // Not enough slack: own wakeup, before the other thread
+    _other_woke = 0;
+    semaphore_post(&_go);
+    thread_sleep_slack(OTHER_SLEEP - 4, 1);
+    OS_ASSERT(_other_woke == 0);
+    OS_ASSERT(thread_sleep_coalesced() == 1);
+    thread_sleep(4);
+    OS_ASSERT(_other_woke != 0);
+
+    // Nothing else sleeping: on time
+    now = thread_tick_count();
+    thread_sleep_slack(3, 5);
+    OS_ASSERT(thread_tick_count() - now <= 4);
+    OS_ASSERT(thread_sleep_coalesced() == 1);
+
+    // Timeout shares the other thread's wakeup
+    _other_woke = 0;
+    semaphore_post(&_go);
+    OS_ASSERT(!semaphore_timed_pend_slack(&_never, OTHER_SLEEP - 1, 2));
+    OS_ASSERT(thread_tick_count() == _other_woke);
+    OS_ASSERT(thread_sleep_coalesced() == 2);
+
+    exit(0);
+}
@@ -0,0 +1,137 @@
+#include "test.h"
+#include <stdarg.h>
+#include <string.h>
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define MAX_THREADS     8
+#define OUT_SIZE        8192
+
+// Sleep well past the snapshot (time units)
+#ifdef CONFIG_RTOS_ABSOLUTE_TIME
+    #define SLEEP_TIME  1000000000
+#else
+    #define SLEEP_TIME  1000
+#endif
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+THREAD_DECL(quote, 1024);
+THREAD_DECL(slash, 1024);
+
+static struct semaphore _sema;
+static char             _out[OUT_SIZE];
+static int              _out_len;
+static int              _masked_prints;
+
+//-----------------------------------------------------------------
+// sleeper_func: Still sleeping when the snapshot is taken
+//-----------------------------------------------------------------
+static void* sleeper_func(void *arg)
+{
+    thread_sleep(SLEEP_TIME);
+    return NULL;
+}
+//-----------------------------------------------------------------
+// blocker_func: Block on the semaphore
+//-----------------------------------------------------------------
+static void* blocker_func(void *arg)
+{
+    semaphore_pend(&_sema);
+    return NULL;
+}
+//-----------------------------------------------------------------
+// out_printf: Capture output, noting any made with interrupts masked
+//-----------------------------------------------------------------
+static int out_printf(const char* fmt, ...)
+{
+    va_list args;
+    int len;
+
+    if (thread_current()->tcb.critical_depth != 0)
+        _masked_prints++;
+
+    va_start(args, fmt);
+    len = vsnprintf(&_out[_out_len], OUT_SIZE - _out_len, fmt, args);
+    va_end(args);
+
+    _out_len += len;
+    OS_ASSERT(_out_len < OUT_SIZE);
+
+    return len;
+}
+//-----------------------------------------------------------------
+// find_info: Find thread in a snapshot
+//-----------------------------------------------------------------
+static struct thread_info *find_info(struct thread_info *info, int count, struct thread *pThread)
+{
+    int i;
+
+    for (i=0;i<count;i++)
+        if (info[i].thread == pThread)
+            return &info[i];
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct thread_info info[MAX_THREADS];
+    struct thread_info *p;
+    int threads;
+    int count;
+
+    // INIT, idle and any kernel threads
+    threads = thread_snapshot(info, MAX_THREADS);
+    OS_ASSERT(threads >= 2);
+
+    semaphore_init(&_sema, 0);
+    THREAD_INIT(quote, "a\"b", sleeper_func, NULL, THREAD_MAX_PRIO);
+    THREAD_INIT(slash, "c\\d", blocker_func, NULL, THREAD_MAX_PRIO);
+    thread_sleep(1);
+
+    // Plus the two test threads
+    count = thread_snapshot(info, MAX_THREADS);
+    OS_ASSERT(count == threads + 2);
+
+    p = find_info(info, count, thread_current());
+    OS_ASSERT(p && p->current && p->state == THREAD_RUNABLE);
+
+    p = find_info(info, count, &thread_quote);
+    OS_ASSERT(p && !p->current && p->state == THREAD_SLEEPING);
+    OS_ASSERT(p->sleep_time > SLEEP_TIME / 10 * 9 && p->sleep_time <= SLEEP_TIME);
+    OS_ASSERT(!strcmp(p->name, "a\"b"));
+    OS_ASSERT(p->stack_size > 0 && p->stack_free > 0 && p->stack_free <= p->stack_size);
+
+    p = find_info(info, count, &thread_slash);
+    OS_ASSERT(p && p->state == THREAD_BLOCKED && p->sleep_time == 0);
+
+    // Truncated snapshot
+    OS_ASSERT(thread_snapshot(info, 2) == 2);
+    OS_ASSERT(thread_snapshot(NULL, 0) == 0);
+
+    // JSON names are escaped
+    count = thread_snapshot(info, MAX_THREADS);
+    thread_snapshot_print_json(info, count, out_printf);
+    printf("%s", _out);
+    OS_ASSERT(strstr(_out, "\"name\":\"a\\\"b\"") != NULL);
+    OS_ASSERT(strstr(_out, "\"name\":\"c\\\\d\"") != NULL);
+    OS_ASSERT(_masked_prints == 0);
+
+    // Thread dump walks the lists directly with interrupts masked
+    _out_len = 0;
+    thread_dump_list(out_printf);
+    printf("%s", _out);
+    OS_ASSERT(strstr(_out, "IDLE_TASK") != NULL);
+    OS_ASSERT(strstr(_out, "a\"b") != NULL);
+    OS_ASSERT(strstr(_out, "c\\d") != NULL);
+    OS_ASSERT(_masked_prints > 0);
+
+    semaphore_post(&_sema);
+
+    exit(0);
+}
@@ -0,0 +1,73 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+THREAD_DECL(high, 1024);
+
+static volatile int _high_runs;
+static struct semaphore _sema;
+
+//-----------------------------------------------------------------
+// high_func: Count each time it gets to run
+//-----------------------------------------------------------------
+static void* high_func(void *arg)
+{
+    while (1)
+    {
+        _high_runs++;
+        semaphore_pend(&_sema);
+    }
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// spin_ticks: Busy wait (no blocking) for a number of ticks
+//-----------------------------------------------------------------
+static void spin_ticks(uint32_t ticks)
+{
+    uint32_t end = thread_tick_count() + ticks;
+
+    while ((int32_t)(thread_tick_count() - end) < 0)
+        ;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_PREEMPT_THRESHOLD
+    struct thread *self = thread_current();
+
+    semaphore_init(&_sema, 0);
+
+    OS_ASSERT(!thread_set_preempt_threshold(self, THREAD_MAX_PRIO + 1));
+    OS_ASSERT(thread_set_preempt_threshold(self, THREAD_MAX_PRIO));
+
+    // Higher priority thread made run-able: no preemption on the tick
+    THREAD_INIT(high, "high", high_func, NULL, THREAD_MAX_PRIO);
+    spin_ticks(3);
+    OS_ASSERT(_high_runs == 0);
+
+    // Runs once this thread blocks
+    thread_sleep(1);
+    OS_ASSERT(_high_runs == 1);
+
+    // Woken by this thread: no preemption
+    semaphore_post(&_sema);
+    OS_ASSERT(_high_runs == 1);
+    spin_ticks(2);
+    OS_ASSERT(_high_runs == 1);
+
+    // Threshold removed: preempted immediately
+    OS_ASSERT(thread_set_preempt_threshold(self, 0));
+    OS_ASSERT(_high_runs == 2);
+
+    semaphore_post(&_sema);
+    OS_ASSERT(_high_runs == 3);
+#endif
+
+    exit(0);
+}
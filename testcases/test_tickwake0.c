@@ -0,0 +1,82 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define WAKERS          12
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#if defined(CONFIG_RTOS_TICK_WAKE_BATCH) && !defined(CONFIG_RTOS_ABSOLUTE_TIME)
+static struct thread _threads[WAKERS];
+static stk_t         _stacks[WAKERS][1024];
+THREAD_DECL(late, 1024);
+
+static uint32_t      _release;
+static uint32_t      _woke[WAKERS];
+static int           _order[WAKERS];
+static volatile int  _runs;
+static uint32_t      _late_woke;
+
+//-----------------------------------------------------------------
+// waker_func: All wake on the same tick, record run order
+//-----------------------------------------------------------------
+static void* waker_func(void *arg)
+{
+    int idx = (int)(long)arg;
+
+    OS_ASSERT(thread_sleep_until(_release));
+    _woke[idx] = thread_tick_count();
+    _order[_runs++] = idx;
+
+    return NULL;
+}
+//-----------------------------------------------------------------
+// late_func: Expires after the spill, must still be on time
+//-----------------------------------------------------------------
+static void* late_func(void *arg)
+{
+    OS_ASSERT(thread_sleep_until(_release + 2));
+    _late_woke = thread_tick_count();
+
+    return NULL;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#if defined(CONFIG_RTOS_TICK_WAKE_BATCH) && !defined(CONFIG_RTOS_ABSOLUTE_TIME)
+    int i;
+
+    _release = thread_tick_count() + 5;
+
+    for (i=0;i<WAKERS;i++)
+        thread_init(&_threads[i], "waker", (i % 8) + 1, waker_func, (void*)(long)i, _stacks[i], 1024);
+    THREAD_INIT(late, "late", late_func, NULL, 1);
+
+    thread_sleep_until(_release + 4);
+
+    printf("spills=%d late=%d\n", thread_tick_wake_spills(), _late_woke - _release);
+
+    // More expired than one tick is allowed to wake
+    OS_ASSERT(WAKERS > THREAD_TICK_WAKE_MAX);
+    OS_ASSERT(thread_tick_wake_spills() >= 1);
+
+    // All woken by the release tick, run in priority order
+    OS_ASSERT(_runs == WAKERS);
+    for (i=0;i<WAKERS;i++)
+    {
+        OS_ASSERT(_woke[i] - _release <= 1);
+        if (i > 0)
+            OS_ASSERT(_threads[_order[i-1]].priority >= _threads[_order[i]].priority);
+    }
+
+    // Delta list still correct after the deferred pass
+    OS_ASSERT(_late_woke == _release + 2);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,113 @@
+#include "test.h"
+#include "kernel/os_timer.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define MAX_FIRES       16
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static struct os_timer  _oneshot;
+static struct os_timer  _periodic;
+static struct os_timer  _stopped;
+
+static volatile int     _oneshot_fires;
+static uint32_t         _oneshot_tick;
+static volatile int     _periodic_fires;
+static uint32_t         _periodic_tick[MAX_FIRES];
+static volatile int     _stopped_fires;
+
+//-----------------------------------------------------------------
+// oneshot_func: Runs in the tick interrupt
+//-----------------------------------------------------------------
+static void oneshot_func(void *arg)
+{
+    _oneshot_fires++;
+    _oneshot_tick = thread_tick_count();
+}
+//-----------------------------------------------------------------
+// periodic_func: Runs in the timer service thread
+//-----------------------------------------------------------------
+static void periodic_func(void *arg)
+{
+    OS_ASSERT(thread_current()->priority == OS_TIMER_THREAD_PRIO);
+
+    if (_periodic_fires < MAX_FIRES)
+        _periodic_tick[_periodic_fires] = thread_tick_count();
+    _periodic_fires++;
+}
+//-----------------------------------------------------------------
+// stopped_func: Should never run
+//-----------------------------------------------------------------
+static void stopped_func(void *arg)
+{
+    _stopped_fires++;
+}
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+    struct os_timer_stats stats;
+    uint32_t start;
+    int fires;
+    int i;
+
+    os_timer_init();
+
+    // One-shot in tick context
+    os_timer_create(&_oneshot, oneshot_func, NULL, 3, OS_TIMER_ONE_SHOT | OS_TIMER_TICK_CONTEXT);
+    start = thread_tick_count();
+    os_timer_start(&_oneshot);
+    OS_ASSERT(os_timer_active(&_oneshot));
+    thread_sleep(5);
+    OS_ASSERT(_oneshot_fires == 1);
+    OS_ASSERT(_oneshot_tick == start + 3);
+    OS_ASSERT(!os_timer_active(&_oneshot));
+
+    // Reset pushes the expiry back
+    os_timer_start(&_oneshot);
+    thread_sleep(1);
+    os_timer_reset(&_oneshot);
+    start = thread_tick_count();
+    thread_sleep(5);
+    OS_ASSERT(_oneshot_fires == 2);
+    OS_ASSERT(_oneshot_tick == start + 3);
+
+    // Stopped before expiry
+    os_timer_create(&_stopped, stopped_func, NULL, 2, OS_TIMER_AUTO_RELOAD);
+    os_timer_start(&_stopped);
+    os_timer_stop(&_stopped);
+    OS_ASSERT(!os_timer_active(&_stopped));
+
+    // Auto-reload in the service thread, wraps the wheel
+    os_timer_create(&_periodic, periodic_func, NULL, OS_TIMER_WHEEL_SLOTS / 4 + 1, OS_TIMER_AUTO_RELOAD);
+    start = thread_tick_count();
+    os_timer_start(&_periodic);
+
+    // Repeat init leaves running timers alone
+    os_timer_init();
+    OS_ASSERT(os_timer_active(&_periodic));
+
+    thread_sleep(_periodic.period * 6);
+    os_timer_stop(&_periodic);
+    fires = _periodic_fires;
+
+    OS_ASSERT(fires >= 5 && fires <= MAX_FIRES);
+    for (i=0;i<fires;i++)
+        OS_ASSERT(_periodic_tick[i] == start + (i + 1) * _periodic.period);
+
+    // No more once stopped
+    thread_sleep(_periodic.period * 2);
+    OS_ASSERT(_periodic_fires == fires);
+    OS_ASSERT(_stopped_fires == 0);
+
+    os_timer_get_stats(&_periodic, &stats);
+    printf("fired=%d overruns=%d latency_max=%d\n", stats.fired, stats.overruns, stats.latency_max);
+    OS_ASSERT(stats.fired == (uint32_t)fires);
+    OS_ASSERT(stats.overruns == 0);
+
+    exit(0);
+}
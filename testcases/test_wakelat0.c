@@ -0,0 +1,108 @@
+#include "test.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+// Time the low priority thread is kept waiting (cpu_timenow units)
+#define LOW_DELAY       2000000
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+THREAD_DECL(high, 1024);
+THREAD_DECL(low, 1024);
+
+static volatile int _high_runs;
+static volatile int _low_runs;
+
+//-----------------------------------------------------------------
+// thread_func: Woken once, then exit
+//-----------------------------------------------------------------
+static void* thread_func(void *arg)
+{
+    (*(volatile int *)arg)++;
+    return NULL;
+}
+//-----------------------------------------------------------------
+// expected_bucket: Bucket N holds latencies in [2^N, 2^(N+1))
+//-----------------------------------------------------------------
+static int expected_bucket(uint32_t latency)
+{
+    int bucket;
+
+    latency >>= THREAD_WAKE_HIST_SHIFT;
+    for (bucket=THREAD_WAKE_HIST_BUCKETS-1;bucket>0;bucket--)
+        if (latency >= (1UL << bucket))
+            break;
+
+    return bucket;
+}
+//-----------------------------------------------------------------
+// check_single: One sample recorded, in the bucket for its latency
+// (the only sample is also the maximum)
+//-----------------------------------------------------------------
+static int check_single(struct thread *pThread, uint32_t min_latency)
+{
+    uint32_t hist[THREAD_WAKE_HIST_BUCKETS];
+    uint32_t max;
+    int bucket = -1;
+    int total = 0;
+    int i;
+
+    OS_ASSERT(thread_get_wake_latency(pThread, hist, THREAD_WAKE_HIST_BUCKETS, &max) == THREAD_WAKE_HIST_BUCKETS);
+
+    for (i=0;i<THREAD_WAKE_HIST_BUCKETS;i++)
+    {
+        total += hist[i];
+        if (hist[i])
+            bucket = i;
+    }
+
+    printf("%s: max=%d bucket=%d\n", pThread->name, max, bucket);
+
+    OS_ASSERT(total == 1);
+    OS_ASSERT(max >= min_latency);
+    OS_ASSERT(bucket == expected_bucket(max));
+    OS_ASSERT(bucket >= expected_bucket(min_latency));
+
+    return bucket;
+}
+#endif
+//-----------------------------------------------------------------
+// Test Thread Function:
+//-----------------------------------------------------------------
+void testcase(void * a)
+{
+#ifdef CONFIG_RTOS_MEASURE_WAKE_LATENCY
+    uint64_t start;
+    int cr;
+
+    // Created blocked, so the only sample is from the unblock below
+    thread_init_ex(&thread_high, "high", THREAD_MAX_PRIO, thread_func, (void*)&_high_runs, stack_high, sizeof(stack_high) / sizeof(stk_t), THREAD_BLOCKED);
+    thread_init_ex(&thread_low, "low", 1, thread_func, (void*)&_low_runs, stack_low, sizeof(stack_low) / sizeof(stk_t), THREAD_BLOCKED);
+
+    // Higher priority: runs straight away
+    cr = critical_start();
+    thread_unblock(&thread_high);
+    critical_end(cr);
+    OS_ASSERT(_high_runs == 1);
+    check_single(&thread_high, 0);
+
+    // Lower priority: waits until this thread sleeps
+    cr = critical_start();
+    thread_unblock(&thread_low);
+    critical_end(cr);
+
+    start = cpu_timenow();
+    while (cpu_timediff(cpu_timenow(), start) < LOW_DELAY)
+        ;
+    OS_ASSERT(_low_runs == 0);
+
+    thread_sleep(1);
+    OS_ASSERT(_low_runs == 1);
+    check_single(&thread_low, LOW_DELAY);
+#endif
+
+    exit(0);
+}
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+#-----------------------------------------------------------------
+# funcprof.py: Symbolise a function profile captured by
+# func_profile_dump() (CONFIG_RTOS_FUNC_PROFILE) into a flat profile
+# and call graph summary.
+#
+# Usage:
+#   funcprof.py firmware.elf profile.csv [--nm riscv32-unknown-elf-nm]
+#               [--top N]
+#
+# profile.csv is the console output of func_profile_dump (other lines
+# in the capture are ignored).
+#-----------------------------------------------------------------
+import argparse
+import re
+import sys
+
+from pcprof import load_symbols, lookup
+
+FUNC_RE = re.compile(r'^\s*F,(\S+),(\d+),(\d+),(\d+)\s*$')
+EDGE_RE = re.compile(r'^\s*E,(\S+),(\S+),(\d+),(\d+)\s*$')
+HDR_RE  = re.compile(r'^#\s*funcprof\s+(.*)$')
+
+#-----------------------------------------------------------------
+# parse_addr: %p output (NULL may be printed as (nil) or 0)
+#-----------------------------------------------------------------
+def parse_addr(s):
+    if s in ('(nil)', '(null)'):
+        return 0
+    return int(s, 16)
+
+#-----------------------------------------------------------------
+# main
+#-----------------------------------------------------------------
+def main():
+    parser = argparse.ArgumentParser(description='librtos function profiler')
+    parser.add_argument('elf')
+    parser.add_argument('profile')
+    parser.add_argument('--nm', default='riscv32-unknown-elf-nm')
+    parser.add_argument('--top', type=int, default=0, help='only show the top N functions')
+    args = parser.parse_args()
+
+    funcs = []
+    edges = []
+    header = None
+    with open(args.profile) as f:
+        for line in f:
+            m = HDR_RE.match(line)
+            if m:
+                header = m.group(1).strip()
+                continue
+            m = FUNC_RE.match(line)
+            if m:
+                funcs.append((parse_addr(m.group(1)), int(m.group(2)), int(m.group(3)), int(m.group(4))))
+                continue
+            m = EDGE_RE.match(line)
+            if m:
+                edges.append((parse_addr(m.group(1)), parse_addr(m.group(2)), int(m.group(3)), int(m.group(4))))
+
+    if not funcs:
+        sys.stderr.write('No functions found in %s\n' % args.profile)
+        return 1
+
+    syms = load_symbols(args.nm, args.elf)
+    addrs = [s[0] for s in syms]
+    name = lambda pc: '<thread>' if pc == 0 else lookup(syms, addrs, pc)
+
+    # Flat profile (sorted by exclusive time)
+    total = sum(f[3] for f in funcs) or 1
+    funcs.sort(key=lambda f: -f[3])
+    if args.top:
+        funcs = funcs[:args.top]
+
+    if header:
+        print('Capture: %s\n' % header)
+
+    print('Flat profile:')
+    print('  %7s %14s %14s %9s  %s' % ('excl %', 'exclusive', 'inclusive', 'calls', 'function'))
+    for func, calls, incl, excl in funcs:
+        print('  %6.2f%% %14d %14d %9d  %s' % (100.0 * excl / total, excl, incl, calls, name(func)))
+    print('')
+
+    # Call graph: callers and callees of each function in the flat profile
+    print('Call graph:')
+    for func, calls, incl, excl in funcs:
+        print('  %s  (calls %d, inclusive %d, exclusive %d)' % (name(func), calls, incl, excl))
+        for caller, callee, ecalls, eincl in sorted(edges, key=lambda e: -e[3]):
+            if callee == func:
+                print('    <- %-40s %9d calls %14d' % (name(caller), ecalls, eincl))
+        for caller, callee, ecalls, eincl in sorted(edges, key=lambda e: -e[3]):
+            if caller == func:
+                print('    -> %-40s %9d calls %14d' % (name(callee), ecalls, eincl))
+        print('')
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+#-----------------------------------------------------------------
+# pcprof.py: Symbolise PC samples captured by cpu_pc_sample_dump()
+# (CONFIG_RTOS_PC_SAMPLING) into a per-thread flat profile.
+#
+# Usage:
+#   pcprof.py firmware.elf samples.csv [--nm riscv32-unknown-elf-nm]
+#             [--addr2line riscv32-unknown-elf-addr2line] [--lines]
+#             [--top N]
+#
+# samples.csv is the console output of cpu_pc_sample_dump (other lines
+# in the capture are ignored).
+#-----------------------------------------------------------------
+import argparse
+import bisect
+import re
+import subprocess
+import sys
+
+ROW_RE = re.compile(r'^\s*(-?\d+),([^,]*),(0x[0-9a-fA-F]+),(\d+)\s*$')
+HDR_RE = re.compile(r'^#\s*pcprof\s+(.*)$')
+
+#-----------------------------------------------------------------
+# load_symbols: Sorted list of (addr, size, name) for text symbols
+#-----------------------------------------------------------------
+def load_symbols(nm, elf):
+    out = subprocess.check_output([nm, '-S', '-C', '--defined-only', elf],
+                                  universal_newlines=True)
+    syms = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and parts[2] in 'tTwW':
+            syms.append((int(parts[0], 16), int(parts[1], 16), parts[3]))
+        elif len(parts) == 3 and parts[1] in 'tTwW':
+            syms.append((int(parts[0], 16), 0, parts[2]))
+    syms.sort()
+    return syms
+
+#-----------------------------------------------------------------
+# lookup: Function containing 'pc'
+#-----------------------------------------------------------------
+def lookup(syms, addrs, pc):
+    i = bisect.bisect_right(addrs, pc) - 1
+    if i < 0:
+        return '0x%08x' % pc
+    addr, size, name = syms[i]
+    if size and pc >= addr + size:
+        return '0x%08x' % pc
+    return name
+
+#-----------------------------------------------------------------
+# lookup_lines: file:line for each PC (via addr2line)
+#-----------------------------------------------------------------
+def lookup_lines(addr2line, elf, pcs):
+    if not pcs:
+        return {}
+    args = [addr2line, '-e', elf] + ['0x%x' % pc for pc in pcs]
+    out = subprocess.check_output(args, universal_newlines=True).splitlines()
+    return dict(zip(pcs, out))
+
+#-----------------------------------------------------------------
+# print_profile: Flat profile for one thread (or all)
+#-----------------------------------------------------------------
+def print_profile(title, counts, top, column):
+    total = sum(counts.values())
+    print('%s: %d samples' % (title, total))
+    print('  %7s %7s  %s' % ('%', 'samples', column))
+    rows = sorted(counts.items(), key=lambda x: (-x[1], x[0]))
+    if top:
+        rows = rows[:top]
+    for name, count in rows:
+        print('  %6.2f%% %7d  %s' % (100.0 * count / total, count, name))
+    print('')
+
+#-----------------------------------------------------------------
+# main
+#-----------------------------------------------------------------
+def main():
+    parser = argparse.ArgumentParser(description='librtos PC sample profiler')
+    parser.add_argument('elf')
+    parser.add_argument('samples')
+    parser.add_argument('--nm', default='riscv32-unknown-elf-nm')
+    parser.add_argument('--addr2line', default='riscv32-unknown-elf-addr2line')
+    parser.add_argument('--lines', action='store_true', help='profile by source line rather than function')
+    parser.add_argument('--top', type=int, default=0, help='only show the top N entries per thread')
+    args = parser.parse_args()
+
+    samples = []
+    header = None
+    with open(args.samples) as f:
+        for line in f:
+            m = HDR_RE.match(line)
+            if m:
+                header = m.group(1).strip()
+                continue
+            m = ROW_RE.match(line)
+            if m:
+                samples.append((int(m.group(1)), m.group(2), int(m.group(3), 16), int(m.group(4))))
+
+    if not samples:
+        sys.stderr.write('No samples found in %s\n' % args.samples)
+        return 1
+
+    if args.lines:
+        where = lookup_lines(args.addr2line, args.elf, sorted(set(s[2] for s in samples)))
+        symbolise = lambda pc: where.get(pc, '0x%08x' % pc)
+    else:
+        syms = load_symbols(args.nm, args.elf)
+        addrs = [s[0] for s in syms]
+        symbolise = lambda pc: lookup(syms, addrs, pc)
+
+    threads = {}
+    overall = {}
+    for thread_id, name, pc, count in samples:
+        key = (thread_id, name)
+        func = symbolise(pc)
+        per = threads.setdefault(key, {})
+        per[func] = per.get(func, 0) + count
+        overall[func] = overall.get(func, 0) + count
+
+    if header:
+        print('Capture: %s\n' % header)
+
+    column = 'line' if args.lines else 'function'
+    print_profile('All threads', overall, args.top, column)
+
+    for (thread_id, name), counts in sorted(threads.items(), key=lambda x: -sum(x[1].values())):
+        print_profile('Thread %d (%s)' % (thread_id, name), counts, args.top, column)
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())